@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "version.h"
+#include <libocn/counters.h++>
+#include <libocn/mesh_network.h++>
+#include <libocn/cmesh_network.h++>
+#include <libocn/dmesh_network.h++>
+#include <libocn/crossbar_network.h++>
+#include <libocn/crossmesh_network.h++>
+#include <libocn/plain_node.h++>
+#include <libocn/sizet_printf.h++>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef libocn::plain_node node_t;
+typedef libocn::network<node_t> network_t;
+
+/* The number of allocations made so far, which is counted by the
+ * replacement "operator new" in "bench_allocations.c++". */
+size_t allocation_count(void);
+
+/* A single benchmark: one topology at one size. */
+struct bench_case {
+    std::string topology;
+    std::string size;
+    std::function<std::shared_ptr<network_t>(void)> build;
+
+    /* Some networks are loaded from a file, which is generated by
+     * this before the timer starts. */
+    std::function<void(void)> prepare;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/* Writes out a network in the text format that "network" reads. */
+static void write_network(const network_t& network, const std::string& path)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (f == NULL) {
+        perror(path.c_str());
+        abort();
+    }
+
+    auto frozen = network.freeze();
+    for (size_t s = 0; s < frozen->size(); ++s) {
+        for (size_t l = frozen->out_begin(s); l < frozen->out_end(s); ++l) {
+            auto d = frozen->link_dest(l);
+            fprintf(f, "\"%s\" " SIZET_FORMAT " -> \"%s\" " SIZET_FORMAT ": " SIZET_FORMAT "\n",
+                    frozen->at(s)->name().c_str(),
+                    frozen->link_port(l),
+                    frozen->at(d)->name().c_str(),
+                    frozen->port_number_in(d, s),
+                    frozen->link_cost(l)
+                );
+        }
+    }
+
+    fclose(f);
+}
+
+/* Runs a single benchmark, returning its results as a JSON object. */
+static std::string run(const bench_case& c, size_t threads)
+{
+    if (c.prepare)
+        c.prepare();
+
+    libocn::counters::reset();
+    auto allocated = allocation_count();
+
+    auto start = std::chrono::steady_clock::now();
+    auto network = c.build();
+    auto construction = seconds_since(start);
+
+    auto build_allocations = allocation_count() - allocated;
+    allocated = allocation_count();
+
+    /* This is the same work as "ocn-shortest_path", without the
+     * printing: every path is actually materialized. */
+    start = std::chrono::steady_clock::now();
+    network->compute_all_paths(threads);
+    size_t routes = 0;
+    for (const auto& node: network->nodes())
+        routes += node->paths().size();
+    auto shortest_paths = seconds_since(start);
+
+    auto route_allocations = allocation_count() - allocated;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    auto frozen = network->freeze();
+    auto counted = libocn::counters::read();
+
+    char buffer[4096];
+    snprintf(buffer, sizeof(buffer),
+             "    {\n"
+             "      \"topology\": \"%s\",\n"
+             "      \"size\": \"%s\",\n"
+             "      \"nodes\": " SIZET_FORMAT ",\n"
+             "      \"links\": " SIZET_FORMAT ",\n"
+             "      \"routes\": " SIZET_FORMAT ",\n"
+             "      \"construction_seconds\": %.6f,\n"
+             "      \"shortest_paths_seconds\": %.6f,\n"
+             "      \"peak_rss_kb\": %ld,\n"
+             "      \"construction_allocations\": " SIZET_FORMAT ",\n"
+             "      \"allocations_per_route\": %.3f,\n"
+             "      \"counters\": {\n"
+             "        \"relaxations\": " SIZET_FORMAT ",\n"
+             "        \"heap_pushes\": " SIZET_FORMAT ",\n"
+             "        \"paths_allocated\": " SIZET_FORMAT ",\n"
+             "        \"bytes_read\": " SIZET_FORMAT ",\n"
+             "        \"build_steps\": " SIZET_FORMAT "\n"
+             "      }\n"
+             "    }",
+             c.topology.c_str(),
+             c.size.c_str(),
+             frozen->size(),
+             frozen->out_begin(frozen->size()),
+             routes,
+             construction,
+             shortest_paths,
+             usage.ru_maxrss,
+             build_allocations,
+             (routes == 0) ? 0.0 : (double)route_allocations / routes,
+             counted.relaxations,
+             counted.heap_pushes,
+             counted.paths_allocated,
+             counted.bytes_read,
+             counted.build_steps
+        );
+    return buffer;
+}
+
+/* Runs a benchmark in its own process, so its peak memory usage
+ * isn't polluted by the ones that came before it.  Returns the JSON
+ * for the benchmark, or an empty string if it failed. */
+static std::string run_isolated(const bench_case& c, size_t threads)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        abort();
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        abort();
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        auto out = run(c, threads);
+        size_t written = 0;
+        while (written < out.size()) {
+            auto n = write(fds[1], out.c_str() + written, out.size() - written);
+            if (n <= 0)
+                _exit(1);
+            written += n;
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::string out;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0)
+        out.append(buffer, n);
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+        fprintf(stderr, "Benchmark %s %s failed\n",
+                c.topology.c_str(), c.size.c_str());
+        return "";
+    }
+
+    return out;
+}
+
+static std::string dims(size_t x, size_t y)
+{
+    return std::to_string(x) + "x" + std::to_string(y);
+}
+
+static std::string dims(size_t x, size_t y, size_t z)
+{
+    return dims(x, y) + "x" + std::to_string(z);
+}
+
+/* Parses a count from the command line.  strtoul() would happily
+ * wrap a negative number around to something enormous, so anything
+ * that isn't just digits is rejected. */
+static size_t parse_count(const char *option, const char *arg)
+{
+    char *end;
+    errno = 0;
+    unsigned long out = strtoul(arg, &end, 10);
+    if ((arg[0] < '0') || (arg[0] > '9') || (*end != '\0') || (errno != 0)) {
+        fprintf(stderr, "Invalid count for %s: '%s'\n", option, arg);
+        exit(1);
+    }
+    return out;
+}
+
+int main(int argc, const char **argv)
+{
+    size_t threads = 1;
+    size_t steps = 3;
+    std::string scratch = "ocn-bench.network";
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc)) {
+            threads = parse_count(argv[i], argv[i + 1]);
+            i++;
+        } else if ((strcmp(argv[i], "--steps") == 0) && (i + 1 < argc)) {
+            steps = parse_count(argv[i], argv[i + 1]);
+            i++;
+        } else if ((strcmp(argv[i], "--scratch") == 0) && (i + 1 < argc)) {
+            scratch = argv[++i];
+        } else {
+            printf("%s: Benchmark libocn, printing JSON\n", argv[0]);
+            printf("\t--threads <count>: Use this many threads (0 for all)\n");
+            printf("\t--steps <count>: Double the sizes this many times\n");
+            printf("\t--scratch <file>: Where to write file-based networks\n");
+            return (strcmp(argv[i], "--help") == 0) ? 0 : 1;
+        }
+    }
+
+    /* Every topology starts small and doubles along each side at
+     * every step. */
+    std::vector<bench_case> cases;
+    for (size_t step = 0; step < steps; ++step) {
+        size_t k = (size_t)1 << step;
+
+        cases.push_back(bench_case{
+                "mesh", dims(8 * k, 8 * k),
+                [=]() {
+                    return std::make_shared<libocn::mesh_network<node_t>>(
+                        8 * k, 8 * k,
+                        libocn::mesh_network<node_t>::create_node);
+                },
+                NULL});
+
+        cases.push_back(bench_case{
+                "dmesh", dims(8 * k, 8 * k),
+                [=]() {
+                    return std::make_shared<libocn::dmesh_network<node_t>>(
+                        8 * k, 8 * k,
+                        libocn::mesh_network<node_t>::create_node);
+                },
+                NULL});
+
+        cases.push_back(bench_case{
+                "cmesh", dims(4 * k, 4 * k, 4),
+                [=]() {
+                    return std::make_shared<libocn::cmesh_network<node_t>>(
+                        4 * k, 4 * k, 4,
+                        libocn::cmesh_network<node_t>::create_node);
+                },
+                NULL});
+
+        cases.push_back(bench_case{
+                "crossbar", std::to_string(16 * k),
+                [=]() {
+                    return std::make_shared<libocn::crossbar_network<node_t>>(
+                        16 * k,
+                        libocn::crossbar_network<node_t>::create_node);
+                },
+                NULL});
+
+        cases.push_back(bench_case{
+                "crossmesh", dims(2 * k, 2 * k, 16),
+                [=]() {
+                    return std::make_shared<libocn::crossmesh_network<node_t>>(
+                        2 * k, 2 * k, 16,
+                        libocn::crossmesh_network<node_t>::create_node);
+                },
+                NULL});
+
+        /* The file-based networks are meshes that have been written
+         * out, so the search can't use the mesh's oracle. */
+        cases.push_back(bench_case{
+                "file", dims(8 * k, 8 * k),
+                [=]() {
+                    return std::make_shared<network_t>(
+                        scratch,
+                        [](std::string name) {
+                            return std::make_shared<node_t>(name);
+                        });
+                },
+                [=]() {
+                    libocn::mesh_network<node_t> mesh(
+                        8 * k, 8 * k,
+                        libocn::mesh_network<node_t>::create_node);
+                    write_network(mesh, scratch);
+                }});
+    }
+
+    printf("{\n");
+    printf("  \"version\": \"%s\",\n", PCONFIGURE_VERSION);
+    printf("  \"threads\": " SIZET_FORMAT ",\n", threads);
+    printf("  \"counters\": %s,\n",
+           libocn::counters::enabled() ? "true" : "false");
+    printf("  \"results\": [");
+
+    bool first = true;
+    for (const auto& c: cases) {
+        auto result = run_isolated(c, threads);
+        if (result.size() == 0)
+            continue;
+
+        printf("%s\n%s", first ? "" : ",", result.c_str());
+        fflush(stdout);
+        first = false;
+    }
+
+    printf("\n  ]\n");
+    printf("}\n");
+
+    unlink(scratch.c_str());
+    return 0;
+}
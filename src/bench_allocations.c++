@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+/* Every allocation in "ocn-bench" goes through here, so they can be
+ * counted.  These live in their own file so the compiler never sees
+ * a "new" from the benchmark being handed to the "free()" in here,
+ * which it would otherwise complain about. */
+static std::atomic<size_t> allocations(0);
+
+size_t allocation_count(void)
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *out = malloc((size == 0) ? 1 : size);
+    if (out == NULL)
+        throw std::bad_alloc();
+    return out;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
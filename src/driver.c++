@@ -26,20 +26,109 @@
 #include <libocn/crossbar_network.h++>
 #include <libocn/crossmesh_network.h++>
 #include <libocn/plain_node.h++>
+#include <libocn/routing_table.h++>
 #include <libocn/sizet_printf.h++>
+#include <libocn/thread_pool.h++>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Parses a count from the command line.  strtoul() would happily
+ * wrap a negative number around to something enormous, so anything
+ * that isn't just digits is rejected. */
+static size_t parse_count(const char *option, const char *arg)
+{
+    char *end;
+    errno = 0;
+    unsigned long out = strtoul(arg, &end, 10);
+    if ((arg[0] < '0') || (arg[0] > '9') || (*end != '\0') || (errno != 0)) {
+        fprintf(stderr, "Invalid count for %s: '%s'\n", option, arg);
+        exit(1);
+    }
+    return out;
+}
+
 int main(int argc, const char **argv)
 {
+    /* Options that don't describe the network can be given before
+     * any of the network arguments, they're stripped off here so the
+     * argument counts below don't need to know about them.  Link
+     * changes and copies are only used when computing shortest
+     * paths, and table formats only when building routing tables, so
+     * they're not accepted anywhere else. */
+#if defined(SHORTEST_PATHS)
+    struct link_change {
+        const char *source;
+        const char *dest;
+        bool remove;
+        size_t cost;
+    };
+    std::vector<link_change> changes;
+#endif
+    size_t threads = 1;
+    size_t copies = 1;
+    const char *snapshot = NULL;
+#if defined(ROUTING_TABLE)
+    bool intervals = false;
+    bool walk = false;
+#endif
+    while (argc >= 2) {
+        int used = 0;
+
+        if ((argc >= 3) && (strcmp(argv[1], "--threads") == 0)) {
+            threads = parse_count(argv[1], argv[2]);
+            used = 2;
+#if defined(SHORTEST_PATHS)
+        } else if ((argc >= 3) && (strcmp(argv[1], "--copies") == 0)) {
+            copies = parse_count(argv[1], argv[2]);
+            used = 2;
+        } else if ((argc >= 4) && (strcmp(argv[1], "--remove-link") == 0)) {
+            changes.push_back(link_change{argv[2], argv[3], true, 0});
+            used = 3;
+        } else if ((argc >= 5) && (strcmp(argv[1], "--link-cost") == 0)) {
+            changes.push_back(link_change{argv[2], argv[3], false,
+                        parse_count(argv[1], argv[4])});
+            used = 4;
+#endif
+#if defined(ROUTING_TABLE)
+        } else if (strcmp(argv[1], "--intervals") == 0) {
+            intervals = true;
+            used = 1;
+        } else if (strcmp(argv[1], "--walk") == 0) {
+            walk = true;
+            used = 1;
+#endif
+        } else if ((argc >= 3) && (strcmp(argv[1], "--write-snapshot") == 0)) {
+            snapshot = argv[2];
+            used = 2;
+        } else
+            break;
+
+        argv[used] = argv[0];
+        argv += used;
+        argc -= used;
+    }
+
     if ((argc < 2) || (strcmp(argv[1], "--help") == 0)) {
         printf("%s: Compute all shortest paths for a network\n", argv[0]);
+        printf("\t--threads <count>: Use this many threads (0 for all)\n");
+#if defined(SHORTEST_PATHS)
+        printf("\t--copies <count>: Build this many copies at once, printing each\n");
+        printf("\t--remove-link <source> <dest>: Remove a link afterwards\n");
+        printf("\t--link-cost <source> <dest> <cost>: Set (or add) a link afterwards\n");
+#endif
+        printf("\t--write-snapshot <file>: Save the network as a snapshot\n");
+#if defined(ROUTING_TABLE)
+        printf("\t--intervals: Store routing tables as intervals\n");
+        printf("\t--walk: Print the paths found by walking routing tables\n");
+#endif
         printf("\t--mesh <width> <height>: A mesh network\n");
         printf("\t--dmesh <width> <height>: A DREAMER-style mesh, 1 offset\n");
         printf("\t--cmesh <width> <height> <nodes>: Concentrated mesh\n");
         printf("\t--crossbar <nodes>: A full crossbar\n");
         printf("\t--crossmesh <width> <height> <nodes>: Mesh-of-crossbar\n");
+        printf("\t--file <file>: A network file, either text or a snapshot\n");
         return (argc == 2) ? 0 : 1;
     }
 
@@ -50,62 +139,86 @@ int main(int argc, const char **argv)
 
     /* This can be constructed in a number of different ways, but
      * needs to persist below. */
-    std::shared_ptr<libocn::network<libocn::plain_node>> network = NULL;
-
-    if ((argc == 4) && (strcmp(argv[1], "--mesh") == 0)) {
-        network = std::make_shared<libocn::mesh_network<libocn::plain_node>>(
-            atoi(argv[2]),
-            atoi(argv[3]),
-            libocn::mesh_network<libocn::plain_node>::create_node
-            );
-    }
+    typedef std::shared_ptr<libocn::network<libocn::plain_node>> network_ptr;
+    auto build_network = [&](void) -> network_ptr
+        {
+            if ((argc == 4) && (strcmp(argv[1], "--mesh") == 0)) {
+                return std::make_shared<libocn::mesh_network<libocn::plain_node>>(
+                    atoi(argv[2]),
+                    atoi(argv[3]),
+                    libocn::mesh_network<libocn::plain_node>::create_node
+                    );
+            }
 
-    if ((argc == 4) && (strcmp(argv[1], "--dmesh") == 0)) {
-        network = std::make_shared<libocn::dmesh_network<libocn::plain_node>>(
-            atoi(argv[2]),
-            atoi(argv[3]),
-            libocn::mesh_network<libocn::plain_node>::create_node
-            );
-    }
+            if ((argc == 4) && (strcmp(argv[1], "--dmesh") == 0)) {
+                return std::make_shared<libocn::dmesh_network<libocn::plain_node>>(
+                    atoi(argv[2]),
+                    atoi(argv[3]),
+                    libocn::mesh_network<libocn::plain_node>::create_node
+                    );
+            }
 
-    if ((argc == 5) && (strcmp(argv[1], "--cmesh") == 0)) {
-        network = std::make_shared<libocn::cmesh_network<libocn::plain_node>>(
-            atoi(argv[2]),
-            atoi(argv[3]),
-            atoi(argv[4]),
-            libocn::cmesh_network<libocn::plain_node>::create_node
-            );
-    }
+            if ((argc == 5) && (strcmp(argv[1], "--cmesh") == 0)) {
+                return std::make_shared<libocn::cmesh_network<libocn::plain_node>>(
+                    atoi(argv[2]),
+                    atoi(argv[3]),
+                    atoi(argv[4]),
+                    libocn::cmesh_network<libocn::plain_node>::create_node
+                    );
+            }
 
-    if ((argc == 3) && (strcmp(argv[1], "--crossbar") == 0)) {
-        network = std::make_shared<libocn::crossbar_network<libocn::plain_node>>(
-            atoi(argv[2]),
-            libocn::crossbar_network<libocn::plain_node>::create_node
-            );
-    }
+            if ((argc == 3) && (strcmp(argv[1], "--crossbar") == 0)) {
+                return std::make_shared<libocn::crossbar_network<libocn::plain_node>>(
+                    atoi(argv[2]),
+                    libocn::crossbar_network<libocn::plain_node>::create_node
+                    );
+            }
 
-    if ((argc == 5) && (strcmp(argv[1], "--crossmesh") == 0)) {
-        network = std::make_shared<libocn::crossmesh_network<libocn::plain_node>>(
-            atoi(argv[2]),
-            atoi(argv[3]),
-            atoi(argv[4]),
-            libocn::crossmesh_network<libocn::plain_node>::create_node
-            );
-    }
+            if ((argc == 5) && (strcmp(argv[1], "--crossmesh") == 0)) {
+                return std::make_shared<libocn::crossmesh_network<libocn::plain_node>>(
+                    atoi(argv[2]),
+                    atoi(argv[3]),
+                    atoi(argv[4]),
+                    libocn::crossmesh_network<libocn::plain_node>::create_node
+                    );
+            }
 
-    if ((argc == 3) && (strcmp(argv[1], "--file") == 0)) {
-        network = std::make_shared<libocn::network<libocn::plain_node>>(
-            argv[2],
-            [](std::string s) -> std::shared_ptr<libocn::plain_node>
-            {
-                return std::make_shared<libocn::plain_node>(s);
+            if ((argc == 3) && (strcmp(argv[1], "--file") == 0)) {
+                return std::make_shared<libocn::network<libocn::plain_node>>(
+                    argv[2],
+                    [](std::string s) -> std::shared_ptr<libocn::plain_node>
+                    {
+                        return std::make_shared<libocn::plain_node>(s);
+                    }
+                    );
             }
-            );
-    }
 
-    if (network == NULL) {
+            return NULL;
+        };
+
+    /* Every network numbers its own nodes, so any number of copies
+     * of the same network can be built at once.  Every copy gets the
+     * same link changes, so snapshots just save the first one. */
+    std::vector<network_ptr> networks(copies);
+    libocn::thread_pool(threads).run(
+        copies,
+        [&](size_t worker __attribute__((unused)), size_t i)
+        {
+            networks[i] = build_network();
+        });
+
+    if ((copies == 0) || (networks[0] == NULL)) {
         exit(1);
     }
+    auto network = networks[0];
+
+    /* Nothing but computing shortest paths changes the network, so
+     * everything else can write its snapshot up front.  That leaves
+     * them free to drop the network once they're done with it. */
+#if !defined(SHORTEST_PATHS)
+    if (snapshot != NULL)
+        network->write_snapshot(snapshot, false);
+#endif
 
 #if defined(DOT)
     printf("digraph Network {\n");
@@ -113,27 +226,174 @@ int main(int argc, const char **argv)
 #endif
 
 #if defined(SHORTEST_PATHS)
-    for (const auto& node : network->nodes()) {
-        for (const auto& path : node->paths()) {
-            printf("\"%s\" -> \"%s\": " SIZET_FORMAT "\n",
-                   path->s()->name().c_str(),
-                   path->d()->name().c_str(),
-                   path->cost()
-                );
+    for (const auto& copy: networks) {
+        copy->compute_all_paths(threads);
+
+        /* Link changes are applied after the routes have been computed,
+         * so they exercise the incremental route updates. */
+        for (const auto& change: changes) {
+            auto s = copy->lookup(change.source);
+            auto d = copy->lookup(change.dest);
+            if ((s == NULL) || (d == NULL)) {
+                fprintf(stderr, "Unknown link '%s' -> '%s'\n",
+                        change.source, change.dest);
+                return 1;
+            }
+
+            if (change.remove == true)
+                copy->remove_link(s, d);
+            else if (s->find_link(d) == NULL)
+                copy->add_link(s, d, change.cost);
+            else
+                copy->set_link_cost(s, d, change.cost);
+        }
+        if (changes.size() != 0) {
+            fprintf(stderr, "Recomputed routes for " SIZET_FORMAT " sources\n",
+                    copy->routes_recomputed());
+        }
+
+        for (const auto& node : copy->nodes()) {
+            for (const auto& path : node->paths()) {
+                printf("\"%s\" -> \"%s\": " SIZET_FORMAT "\n",
+                       path->s()->name().c_str(),
+                       path->d()->name().c_str(),
+                       path->cost()
+                    );
+            }
         }
     }
 #elif defined(NEIGHBORS)
-    for (const auto& node : network->nodes()) {
-        for (const auto& path : node->outgoing_neighbors()) {
+    /* The frozen view (and the links inside it) has to outlive the
+     * network it came from, so the network is thrown away before
+     * anything gets printed. */
+    auto frozen = network->freeze();
+    networks.clear();
+    network = NULL;
+
+    for (size_t s = 0; s < frozen->size(); ++s) {
+        for (size_t l = frozen->out_begin(s); l < frozen->out_end(s); ++l) {
+            auto d = frozen->link_dest(l);
+            auto link = frozen->link_path(l);
             printf("\"%s\" " SIZET_FORMAT " -> \"%s\" " SIZET_FORMAT ": " SIZET_FORMAT "\n",
-                   path->s()->name().c_str(),
-                   path->s()->port_number_out(path->d()),
-                   path->d()->name().c_str(),
-                   path->d()->port_number_in(path->s()),
-                   path->cost()
+                   link->s()->name().c_str(),
+                   frozen->link_port(l),
+                   link->d()->name().c_str(),
+                   frozen->port_number_in(d, s),
+                   link->cost()
                 );
         }
     }
+#elif defined(ORACLE_CHECK)
+    /* Checks the routing oracle against a search of the whole
+     * network, printing out every route that doesn't match. */
+    auto oracle = network->oracle();
+    if (oracle == NULL) {
+        fprintf(stderr, "Network has no routing oracle\n");
+        return 1;
+    }
+
+    auto frozen = network->freeze();
+    std::vector<std::vector<size_t>> costs(frozen->size());
+    libocn::compiled_network<libocn::plain_node>::search_state state;
+    for (size_t s = 0; s < frozen->size(); ++s) {
+        frozen->search(s, state);
+        costs[s] = state.cost;
+    }
+
+    for (size_t s = 0; s < frozen->size(); ++s) {
+        for (size_t d = 0; d < frozen->size(); ++d) {
+            auto cost = oracle->cost(frozen->at(s), frozen->at(d));
+            if (cost != costs[s][d]) {
+                printf("\"%s\" -> \"%s\": cost " SIZET_FORMAT " not " SIZET_FORMAT "\n",
+                       frozen->at(s)->name().c_str(),
+                       frozen->at(d)->name().c_str(),
+                       cost,
+                       costs[s][d]
+                    );
+                continue;
+            }
+
+            if (s == d)
+                continue;
+
+            /* The next hop has to make progress towards the
+             * destination. */
+            auto port = oracle->next_port(frozen->at(s), frozen->at(d));
+            size_t next = frozen->size();
+            for (size_t l = frozen->out_begin(s); l < frozen->out_end(s); ++l)
+                if (frozen->link_port(l) == port)
+                    next = frozen->link_dest(l);
+            if ((next == frozen->size()) || (costs[next][d] + 1 != cost)) {
+                printf("\"%s\" -> \"%s\": bad port " SIZET_FORMAT "\n",
+                       frozen->at(s)->name().c_str(),
+                       frozen->at(d)->name().c_str(),
+                       port
+                    );
+                continue;
+            }
+
+            /* The route has to actually follow links. */
+            auto path = oracle->route(frozen->at(s), frozen->at(d));
+            auto steps = path->steps();
+            bool linked = (steps.size() == cost + 1);
+            for (size_t i = 1; linked && (i < steps.size()); ++i)
+                if (steps[i-1]->is_neighbor(steps[i]) == false)
+                    linked = false;
+            if ((linked == false) || (steps.back() != frozen->at(d))) {
+                printf("\"%s\" -> \"%s\": bad route\n",
+                       frozen->at(s)->name().c_str(),
+                       frozen->at(d)->name().c_str()
+                    );
+            }
+        }
+    }
+#elif defined(ROUTING_TABLE)
+    typedef libocn::routing_table<libocn::plain_node> table_t;
+    table_t table(*network,
+                  intervals ? table_t::format::intervals : table_t::format::dense,
+                  threads);
+    fprintf(stderr, "Routing table uses " SIZET_FORMAT " bytes\n",
+            table.bytes());
+
+    for (size_t s = 0; s < table.size(); ++s) {
+        if (walk == true) {
+            for (size_t d = 0; d < table.size(); ++d) {
+                auto path = table.route(s, d);
+                if (path == NULL)
+                    continue;
+
+                printf("\"%s\" -> \"%s\": " SIZET_FORMAT "\n",
+                       path->s()->name().c_str(),
+                       path->d()->name().c_str(),
+                       path->cost()
+                    );
+            }
+        } else if (intervals == true) {
+            for (size_t i = table.interval_begin(s); i < table.interval_end(s); ++i) {
+                if (table.interval_port(i) == table_t::no_port)
+                    continue;
+
+                printf("\"%s\" -> \"%s\" .. \"%s\": %u\n",
+                       table.at(s)->name().c_str(),
+                       table.at(table.interval_first(i))->name().c_str(),
+                       table.at(table.interval_last(s, i))->name().c_str(),
+                       table.interval_port(i)
+                    );
+            }
+        } else {
+            for (size_t d = 0; d < table.size(); ++d) {
+                auto port = table.next_port(s, d);
+                if (port == table_t::no_port)
+                    continue;
+
+                printf("\"%s\" -> \"%s\": %u\n",
+                       table.at(s)->name().c_str(),
+                       table.at(d)->name().c_str(),
+                       port
+                    );
+            }
+        }
+    }
 #elif defined(NODE_LIST)
     for (const auto& node : network->nodes()) {
         printf("%s\n", node->name().c_str());
@@ -163,5 +423,12 @@ int main(int argc, const char **argv)
     printf("}\n");
 #endif
 
+    /* Shortest-path snapshots are written last, so they include any
+     * link changes along with the routes that have been computed. */
+#if defined(SHORTEST_PATHS)
+    if (snapshot != NULL)
+        network->write_snapshot(snapshot, true);
+#endif
+
     return 0;
 }
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "arena.h++"
+#include "sizet_printf.h++"
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+using namespace libocn;
+
+arena::arena(size_t chunk_size)
+    : _chunks(),
+      _next(NULL),
+      _left(0),
+      _chunk_size(chunk_size),
+      _bytes(0)
+{
+}
+
+arena::~arena(void)
+{
+    for (const auto& chunk: _chunks)
+        free(chunk.first);
+}
+
+void *arena::allocate(size_t bytes, size_t align)
+{
+    auto pad = (align - (uintptr_t)_next % align) % align;
+    if ((_next == NULL) || (pad + bytes > _left)) {
+        new_chunk(bytes + align);
+        pad = (align - (uintptr_t)_next % align) % align;
+    }
+
+    auto out = _next + pad;
+    _next += pad + bytes;
+    _left -= pad + bytes;
+    _bytes += bytes;
+    return out;
+}
+
+void arena::new_chunk(size_t bytes)
+{
+    /* Anything that's too big for a regular chunk just gets a chunk
+     * of its own. */
+    if (bytes < _chunk_size)
+        bytes = _chunk_size;
+
+    auto chunk = (char *)malloc(bytes);
+    if (chunk == NULL) {
+        fprintf(stderr, "Unable to allocate " SIZET_FORMAT " bytes\n",
+                bytes);
+        abort();
+    }
+
+    auto entry = std::make_pair(chunk, bytes);
+    _chunks.insert(std::upper_bound(_chunks.begin(), _chunks.end(), entry),
+                   entry);
+    _next = chunk;
+    _left = bytes;
+}
+
+bool arena::contains(const void *p) const
+{
+    /* Finds the last chunk that starts at or before "p". */
+    auto c = (char *)p;
+    auto after = std::upper_bound(_chunks.begin(), _chunks.end(),
+                                  std::make_pair(c, (size_t)(-1)));
+    if (after == _chunks.begin())
+        return false;
+
+    auto chunk = after - 1;
+    return (c >= chunk->first) && (c < chunk->first + chunk->second);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__ARENA_HXX
+#define LIBOCN__ARENA_HXX
+
+#include <stdlib.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace libocn {
+    /* A bump allocator that hands out memory from a list of large
+     * chunks.  Nothing is ever freed individually: every allocation
+     * goes away at once when the arena is destroyed, which makes
+     * freeing a lot of small objects a handful of calls to free()
+     * rather than one per object.  Arenas are always owned by a
+     * shared pointer, as everything allocated from one keeps it
+     * alive (see "arena_allocator" below).  They aren't thread-safe,
+     * so each one should only be used by a single thread at a
+     * time. */
+    class arena: public std::enable_shared_from_this<arena> {
+    private:
+        /* Every chunk along with its size, sorted by address so
+         * "contains()" can find them quickly. */
+        std::vector<std::pair<char *, size_t>> _chunks;
+        char *_next;
+        size_t _left;
+        size_t _chunk_size;
+        size_t _bytes;
+
+    public:
+        arena(size_t chunk_size = 64 * 1024);
+        ~arena(void);
+
+        /* There's no sense in copying one of these around. */
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        /* Returns some memory that's aligned to "align" bytes, which
+         * must be a power of 2. */
+        void *allocate(size_t bytes, size_t align);
+
+        /* Returns the number of bytes that have been handed out. */
+        size_t bytes(void) const { return _bytes; }
+
+        /* Returns TRUE if the given pointer points into memory that
+         * came from this arena. */
+        bool contains(const void *p) const;
+
+    private:
+        void new_chunk(size_t bytes);
+    };
+
+    /* Lets standard containers (and "std::allocate_shared()") get
+     * their memory from an arena.  Every allocator holds a reference
+     * to its arena, so anything that keeps a copy of the allocator
+     * around (which includes the control block of a shared pointer
+     * made by "std::allocate_shared()") keeps the arena alive too. */
+    template<class T>
+    class arena_allocator {
+        template<class U> friend class arena_allocator;
+
+    private:
+        std::shared_ptr<arena> _arena;
+
+    public:
+        typedef T value_type;
+
+        arena_allocator(arena& a)
+            : _arena(a.shared_from_this())
+            {
+            }
+
+        template<class U>
+        arena_allocator(const arena_allocator<U>& that)
+            : _arena(that._arena)
+            {
+            }
+
+        template<class U> struct rebind {
+            typedef arena_allocator<U> other;
+        };
+
+        T *allocate(size_t n)
+            {
+                return (T *)_arena->allocate(n * sizeof(T), alignof(T));
+            }
+
+        /* Memory only goes back when the whole arena does. */
+        void deallocate(T *p __attribute__((unused)),
+                        size_t n __attribute__((unused)))
+            {
+            }
+
+        template<class U>
+        bool operator==(const arena_allocator<U>& that) const
+            { return _arena == that._arena; }
+
+        template<class U>
+        bool operator!=(const arena_allocator<U>& that) const
+            { return _arena != that._arena; }
+    };
+}
+
+#endif
@@ -24,16 +24,124 @@
 
 #include "network.h++"
 #include "node.h++"
+#include "routing_oracle.h++"
 #include "sizet_printf.h++"
 #include <stdlib.h>
-#include <map>
 #include <functional>
-
-#ifndef BUFFER_SIZE
-#define BUFFER_SIZE 1024
-#endif
+#include <string>
+#include <vector>
 
 namespace libocn {
+    /* Routes packets through a concentrated mesh: every node that
+     * isn't a router goes through its local router, and the routers
+     * use dimension-order routing between themselves.  Nodes are
+     * indexed in the order the cmesh builder outputs them. */
+    template<class node_t>
+    class cmesh_oracle : public routing_oracle<node_t> {
+        typedef std::shared_ptr<node_t> node_ptr;
+
+    private:
+        size_t _x_max, _y_max, _count, _side;
+
+    public:
+        cmesh_oracle(const std::vector<node_ptr>& nodes,
+                     size_t x_max, size_t y_max, size_t count)
+            : routing_oracle<node_t>(nodes),
+              _x_max(x_max),
+              _y_max(y_max),
+              _count(count),
+              _side((size_t)(floor(sqrt(count))))
+            {
+            }
+
+        /* Converts between indices and the position of the router
+         * along with the node's slot in that router, where slot 0
+         * is the router itself. */
+        size_t x(size_t i) const { return column(i) / _side; }
+        size_t y(size_t i) const { return row(i) / _side; }
+        size_t slot(size_t i) const
+            { return (column(i) % _side) * _side + (row(i) % _side); }
+        size_t at(size_t x, size_t y, size_t slot) const
+            {
+                auto c = x * _side + slot / _side;
+                auto r = y * _side + slot % _side;
+                return c * ((_y_max + 1) * _side) + r;
+            }
+
+        virtual size_t distance(size_t s, size_t d) const
+            {
+                if (s == d)
+                    return 0;
+
+                auto leaves = (slot(s) != 0 ? 1 : 0) + (slot(d) != 0 ? 1 : 0);
+                if ((x(s) == x(d)) && (y(s) == y(d)))
+                    return (leaves == 0) ? 1 : leaves;
+
+                return leaves + this->span(x(s), x(d)) + this->span(y(s), y(d));
+            }
+
+        virtual size_t predecessor(size_t s, size_t d) const
+            {
+                if (slot(d) != 0)
+                    return at(x(d), y(d), 0);
+
+                if ((x(s) == x(d)) && (y(s) == y(d)))
+                    return s;
+
+                if (y(d) != y(s))
+                    return at(x(d), this->toward(y(d), y(s)), 0);
+                return at(this->toward(x(d), x(s)), y(d), 0);
+            }
+
+        virtual size_t first_hop(size_t s, size_t d) const
+            {
+                if (slot(s) != 0)
+                    return at(x(s), y(s), 0);
+
+                if ((x(s) == x(d)) && (y(s) == y(d)))
+                    return d;
+
+                if (x(d) != x(s))
+                    return at(this->toward(x(s), x(d)), y(s), 0);
+                return at(x(s), this->toward(y(s), y(d)), 0);
+            }
+
+        /* Nodes only have a single link, to their router.  Routers
+         * link to their nodes first (in slot order), and then to the
+         * neighboring routers in west, east, south, north order. */
+        virtual size_t port(size_t u, size_t v) const
+            {
+                if (slot(u) != 0)
+                    return 0;
+
+                if (slot(v) != 0)
+                    return slot(v) - 1;
+
+                size_t p = _count - 1;
+
+                if (x(v) < x(u))
+                    return p;
+                if (x(u) > 0)
+                    p++;
+
+                if (x(v) > x(u))
+                    return p;
+                if (x(u) < _x_max)
+                    p++;
+
+                if (y(v) < y(u))
+                    return p;
+                if (y(u) > 0)
+                    p++;
+
+                return p;
+            }
+
+    private:
+        size_t column(size_t i) const { return i / ((_y_max + 1) * _side); }
+        size_t row(size_t i) const { return i % ((_y_max + 1) * _side); }
+    };
+
     /* This is a special sort of network that allows for the creation
      * of a cmesh network.  The idea is that the user doesn't need to
      * specify a network configuration file but can instead simply
@@ -52,8 +160,16 @@ namespace libocn {
          * below. */
         cmesh_network(size_t x, size_t y, size_t count,
                       std::function<node_ptr(size_t, size_t, size_t)> f)
-            : network<node_t>(build_cmesh_network(x-1, y-1, count, f))
+            : network<node_t>(
+                [=](arena& links)
+                {
+                    return build_cmesh_network(links, x-1, y-1, count, f);
+                })
             {
+                this->set_oracle(
+                    std::make_shared<cmesh_oracle<node_t>>(this->nodes(),
+                                                           x-1, y-1, count)
+                    );
             }
 
     public:
@@ -64,22 +180,38 @@ namespace libocn {
          * extra-special information in there if they need it. */
         static node_ptr create_node(size_t x, size_t y, size_t b)
             {
-                char buffer[BUFFER_SIZE];
-                snprintf(buffer, BUFFER_SIZE, "(" SIZET_FORMAT "," SIZET_FORMAT ")." SIZET_FORMAT, x, y, b);
-                return std::make_shared<node_t>(buffer);
+                return std::make_shared<node_t>(
+                    "(" + std::to_string(x) + "," + std::to_string(y) + ")."
+                    + std::to_string(b)
+                    );
             }
 
     private:
         /* This is effectively the constructor, the actual constructor
          * functions are just wrappers for this. */
         static std::vector<node_ptr>
-        build_cmesh_network(size_t x_max, size_t y_max, size_t count,
+        build_cmesh_network(arena& links,
+                            size_t x_max, size_t y_max, size_t count,
                             std::function<node_ptr(size_t, size_t, size_t)> f)
             {
                 size_t x_min = 0, y_min = 0;
 
-                std::map<std::pair<size_t, size_t>, node_ptr> grid;
-                std::map<std::pair<size_t, size_t>, std::vector<node_ptr>> ogrid;
+                /* We need to map the crosbar as a square for when
+                 * we're mapping this whole network to a grid. */
+                size_t xbr = (size_t)(floor(sqrt(count)));
+                if ((xbr * xbr) != count) {
+                    fprintf(stderr, "Non-square crossbar\n");
+                    abort();
+                }
+
+                /* Every crossbar group is stored contiguously, in row
+                 * order, with the routing node first. */
+                size_t width = x_max + 1;
+                auto group = [&](size_t x, size_t y) -> size_t
+                    { return (y * width + x) * count; };
+
+                std::vector<node_ptr> nodes;
+                nodes.reserve(width * (y_max + 1) * count);
 
                 /* First we build up all the crossbar groups.  We keep
                  * track of a single node in each crossbar that acts
@@ -88,21 +220,17 @@ namespace libocn {
                     for (size_t x = x_min; x <= x_max; ++x) {
                         /* FIXME: This isn't a crossbar any more and
                          * should be renamed accordingly. */
-                        std::vector<node_ptr> crossbar;
-
-                        for (size_t i = 0; i < count; ++i) {
-                            auto s = f(x, y, i);
-                            crossbar.push_back(s);
-                            if (i == 0)
-                                continue;
+                        for (size_t i = 0; i < count; ++i)
+                            nodes.push_back(f(x, y, i));
 
-                            auto d = crossbar[0];
-                            s->add_path(std::make_shared<path_t>(s, d));
-                            s->add_path(std::make_shared<path_t>(d, s));
+                        auto& d = nodes[group(x, y)];
+                        d->reserve_links(count + 3, count + 3);
+                        for (size_t i = 1; i < count; ++i) {
+                            auto& s = nodes[group(x, y) + i];
+                            s->reserve_links(1, 1);
+                            connect(links, s, d);
+                            connect(links, d, s);
                         }
-
-                        grid[std::make_pair(x, y)] = crossbar[0];
-                        ogrid[std::make_pair(x, y)] = crossbar;
                     }
                 }
 
@@ -110,25 +238,18 @@ namespace libocn {
                  * together. */
                 for (size_t x = x_min; x <= x_max; ++x) {
                     for (size_t y = y_min; y <= y_max; ++y) {
+                        auto& s = nodes[group(x, y)];
                         if (x > x_min)
-                            add_map(grid, x, y, x-1, y+0);
+                            connect(links, s, nodes[group(x-1, y+0)]);
                         if (x < x_max)
-                            add_map(grid, x, y, x+1, y+0);
+                            connect(links, s, nodes[group(x+1, y+0)]);
                         if (y > y_min)
-                            add_map(grid, x, y, x+0, y-1);
+                            connect(links, s, nodes[group(x+0, y-1)]);
                         if (y < y_max)
-                            add_map(grid, x, y, x+0, y+1);
+                            connect(links, s, nodes[group(x+0, y+1)]);
                     }
                 }
 
-                /* We need to map the crosbar as a square for when
-                 * we're mapping this whole network to a grid. */
-                size_t xbr = (size_t)(floor(sqrt(count)));
-                if ((xbr * xbr) != count) {
-                    fprintf(stderr, "Non-square crossbar\n");
-                    abort();
-                }
-
                 /* At this point we've got the whole network built, we
                  * just need to output it in the correct order such
                  * that it'll be mapped correctly by the placement
@@ -136,6 +257,7 @@ namespace libocn {
                  * should be the same as a mesh network, it's just
                  * that we'll have some extra connections. */
                 std::vector<node_ptr> out;
+                out.reserve(nodes.size());
 
                 for (size_t x = 0; x < ((x_max + 1) * xbr); ++x) {
                     for (size_t y = 0; y < ((y_max + 1) * xbr); ++y) {
@@ -151,37 +273,17 @@ namespace libocn {
                         auto cz = (tx * xbr) + ty;
 
                         /* Now push the correct index. */
-                        auto l = ogrid.find(std::make_pair(cx, cy));
-                        if (l == ogrid.end()) {
-                            fprintf(stderr, "Missing crossbar\n");
-                            abort();
-                        }
-                        out.push_back(l->second[cz]);
+                        out.push_back(nodes[group(cx, cy) + cz]);
                     }
                 }
 
                 return out;
             }
 
-        static
-        void add_map(std::map<std::pair<size_t, size_t>, node_ptr>& grid,
-                     size_t sx, size_t sy, size_t dx, size_t dy)
+        static void connect(arena& links,
+                            const node_ptr& s, const node_ptr& d)
             {
-                auto source_l = grid.find(std::make_pair(sx, sy));
-                if (source_l == grid.end()) {
-                    fprintf(stderr, "Unmapped source (" SIZET_FORMAT "," SIZET_FORMAT ")\n", sx, sy);
-                    abort();
-                }
-                auto source = source_l->second;
-
-                auto dest_l = grid.find(std::make_pair(dx, dy));
-                if (dest_l == grid.end()) {
-                    fprintf(stderr, "Unmapped dest (" SIZET_FORMAT "," SIZET_FORMAT ")\n", dx, dy);
-                    abort();
-                }
-                auto dest = dest_l->second;
-
-                source->add_path(std::make_shared<path_t>(source, dest));
+                s->append_link(network<node_t>::new_link(links, s, d));
             }
     };
 }
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__COMPILED_NETWORK_HXX
+#define LIBOCN__COMPILED_NETWORK_HXX
+
+namespace libocn {
+    template<class node_t> class compiled_network;
+}
+
+#include "counters.h++"
+#include "node.h++"
+#include "path.h++"
+#include "sizet_printf.h++"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace libocn {
+    /* A frozen, read-only view of a network.  Every node is given a
+     * dense index between 0 and N-1 and the links are stored as
+     * compressed sparse rows: the outgoing links of node "i" are the
+     * link indices between "out_begin(i)" and "out_end(i)", sorted by
+     * port.  Everything that's needed to walk the graph lives in flat
+     * arrays, so routing and port queries never have to touch a hash
+     * table or a reference count.  Note that this is a snapshot: if
+     * the network changes afterwards then it'll need to be frozen
+     * again. */
+    template<class node_t>
+    class compiled_network {
+        typedef std::shared_ptr<node_t> node_ptr;
+        typedef std::shared_ptr<path<node_t>> path_ptr;
+        typedef path<node_t> path_t;
+
+    public:
+        /* Used to mark an index that doesn't exist: unreachable
+         * nodes, links that don't exist, and so on. */
+        static const size_t npos = (size_t)(-1);
+
+        /* The scratch space used by a single-source search, along
+         * with the results of that search.  This is split out from
+         * the network so that concurrent searches can each have
+         * their own, and so that the buffers can be reused between
+         * searches. */
+        struct search_state {
+            /* The index of the node the search started from. */
+            size_t source;
+
+            /* The cost of getting to every node, or "npos" if it
+             * can't be reached. */
+            std::vector<size_t> cost;
+
+            /* The link that's taken to enter every node on the way
+             * from the source, or "npos" for the source and any
+             * unreachable nodes. */
+            std::vector<size_t> link;
+
+            /* Every reachable node (other than the source) in the
+             * order it was found, which is always in order of
+             * increasing cost, along with the position of every
+             * node in that list. */
+            std::vector<size_t> order;
+            std::vector<size_t> rank;
+
+            /* The heap used by Dijkstra's algorithm. */
+            std::vector<std::pair<size_t, size_t>> heap;
+
+            search_state(void)
+                : source(npos),
+                  cost(),
+                  link(),
+                  order(),
+                  rank(),
+                  heap()
+                {
+                }
+        };
+
+    private:
+        /* Maps every node index back to the node. */
+        std::vector<node_ptr> _nodes;
+
+        /* The outgoing links, as compressed sparse rows. */
+        std::vector<size_t> _out_offsets;
+        std::vector<size_t> _out_source;
+        std::vector<size_t> _out_dest;
+        std::vector<size_t> _out_port;
+        std::vector<size_t> _out_cost;
+        std::vector<path_ptr> _out_path;
+
+        /* The incoming links, as compressed sparse rows. */
+        std::vector<size_t> _in_offsets;
+        std::vector<size_t> _in_source;
+        std::vector<size_t> _in_port;
+
+        /* Set when every link costs 1, in which case searches can
+         * skip the heap entirely. */
+        bool _unit_cost;
+
+    public:
+        /* Freezes the given list of nodes, which is expected to
+         * contain every node that any of them link to.  The list has
+         * to be in UID order (which is how networks store their
+         * nodes), as node indices are just their UIDs. */
+        compiled_network(const std::vector<node_ptr>& nodes)
+            : _nodes(nodes),
+              _out_offsets(),
+              _out_source(),
+              _out_dest(),
+              _out_port(),
+              _out_cost(),
+              _out_path(),
+              _in_offsets(),
+              _in_source(),
+              _in_port(),
+              _unit_cost(true)
+            {
+                build_rows(true);
+                build_rows(false);
+            }
+
+        /* Returns the number of nodes in the network. */
+        size_t size(void) const { return _nodes.size(); }
+
+        /* Converts between dense indices and nodes. */
+        const node_ptr& at(size_t i) const { return _nodes[i]; }
+        const std::vector<node_ptr>& nodes(void) const { return _nodes; }
+
+        size_t index(const node_ptr& n) const
+            {
+                auto i = n->uid();
+                if ((i >= _nodes.size()) || (_nodes[i] != n))
+                    return npos;
+                return i;
+            }
+
+        /* Returns TRUE when every link in the network costs 1. */
+        bool unit_cost(void) const { return _unit_cost; }
+
+        /* Accessors for the outgoing links of a node. */
+        size_t out_begin(size_t i) const { return _out_offsets[i]; }
+        size_t out_end(size_t i) const { return _out_offsets[i+1]; }
+        size_t link_source(size_t l) const { return _out_source[l]; }
+        size_t link_dest(size_t l) const { return _out_dest[l]; }
+        size_t link_port(size_t l) const { return _out_port[l]; }
+        size_t link_cost(size_t l) const { return _out_cost[l]; }
+        const path_ptr& link_path(size_t l) const { return _out_path[l]; }
+
+        /* Accessors for the incoming links of a node. */
+        size_t in_begin(size_t i) const { return _in_offsets[i]; }
+        size_t in_end(size_t i) const { return _in_offsets[i+1]; }
+        size_t in_source(size_t l) const { return _in_source[l]; }
+        size_t in_port(size_t l) const { return _in_port[l]; }
+
+        /* Returns the indices of every node that can be reached from
+         * this node in a single hop. */
+        std::vector<size_t> outgoing_neighbors(size_t i) const
+            {
+                return std::vector<size_t>(_out_dest.begin() + out_begin(i),
+                                           _out_dest.begin() + out_end(i));
+            }
+
+        /* Returns the port number that's used to connect from one
+         * node to a neighboring node, or "npos" if they aren't
+         * neighbors. */
+        size_t port_number_out(size_t s, size_t d) const
+            {
+                for (size_t l = out_begin(s); l < out_end(s); ++l)
+                    if (_out_dest[l] == d)
+                        return _out_port[l];
+                return npos;
+            }
+
+        size_t port_number_in(size_t d, size_t s) const
+            {
+                for (size_t l = in_begin(d); l < in_end(d); ++l)
+                    if (_in_source[l] == s)
+                        return _in_port[l];
+                return npos;
+            }
+
+        /* Finds the shortest path from a source to every other node
+         * in the network, storing the result in "state". */
+        void search(size_t source, search_state& state) const
+            {
+                state.source = source;
+                state.cost.assign(size(), npos);
+                state.link.assign(size(), npos);
+                state.rank.assign(size(), npos);
+                state.order.clear();
+                state.heap.clear();
+
+                state.cost[source] = 0;
+
+                if (_unit_cost == true)
+                    breadth_first_search(state);
+                else
+                    dijkstra_search(state);
+            }
+
+        /* Builds the full path from the source of a search to the
+         * given node, or NULL if it can't be reached. */
+        path_ptr build_path(const search_state& state, size_t d) const
+            {
+                if ((d == state.source) || (state.link[d] == npos))
+                    return NULL;
+
+                auto l = state.link[d];
+                if (_out_source[l] == state.source)
+                    return _out_path[l];
+
+                std::vector<node_ptr> steps;
+                for (auto n = _out_source[l];
+                     n != state.source;
+                     n = _out_source[state.link[n]])
+                    steps.push_back(_nodes[n]);
+                std::reverse(steps.begin(), steps.end());
+
+                return std::make_shared<path_t>(_nodes[state.source],
+                                                _nodes[d],
+                                                steps,
+                                                state.cost[d]);
+            }
+
+        /* Hands the results of a search over to the source node, so
+         * it doesn't need to search again when asked for paths.
+         * This only modifies the source node, so different sources
+         * can be installed concurrently. */
+        void install(const search_state& state) const
+            {
+                _nodes[state.source]->set_routes(*this, state);
+            }
+
+    private:
+        /* Fills out either the outgoing or incoming rows from the
+         * neighbor lists of every node. */
+        void build_rows(bool outgoing)
+            {
+                auto& offsets = outgoing ? _out_offsets : _in_offsets;
+                offsets.reserve(size() + 1);
+                offsets.push_back(0);
+
+                std::vector<std::pair<size_t, path_ptr>> row;
+                for (size_t ni = 0; ni < size(); ++ni) {
+                    const auto& n = _nodes[ni];
+                    const auto& links = outgoing
+                        ? n->_outgoing_neighbors
+                        : n->_incoming_neighbors;
+
+                    row.assign(links.begin(), links.end());
+                    std::sort(row.begin(), row.end(),
+                              [](const std::pair<size_t, path_ptr>& a,
+                                 const std::pair<size_t, path_ptr>& b)
+                              { return a.first < b.first; });
+
+                    for (const auto& pair: row) {
+                        auto other = outgoing
+                            ? pair.second->d()
+                            : pair.second->s();
+
+                        auto i = index(other);
+                        if (i == npos) {
+                            fprintf(stderr, "Link from '%s' to '%s' leaves the network\n",
+                                    pair.second->s()->name().c_str(),
+                                    pair.second->d()->name().c_str()
+                                );
+                            abort();
+                        }
+
+                        if (outgoing == true) {
+                            _out_source.push_back(ni);
+                            _out_dest.push_back(i);
+                            _out_port.push_back(pair.first);
+                            _out_cost.push_back(pair.second->cost());
+                            _out_path.push_back(pair.second);
+                            if (pair.second->cost() != 1)
+                                _unit_cost = false;
+                        } else {
+                            _in_source.push_back(i);
+                            _in_port.push_back(pair.first);
+                        }
+                    }
+
+                    offsets.push_back(outgoing ? _out_dest.size() : _in_source.size());
+                }
+            }
+
+        /* Every link costs 1, so nodes are found in order of
+         * increasing cost and the order list can double as the
+         * search queue. */
+        void breadth_first_search(search_state& state) const
+            {
+                auto visit = [&](size_t n)
+                    {
+                        for (size_t l = out_begin(n); l < out_end(n); ++l) {
+                            auto d = _out_dest[l];
+                            if (state.cost[d] != npos)
+                                continue;
+
+                            state.cost[d] = state.cost[n] + 1;
+                            state.link[d] = l;
+                            state.rank[d] = state.order.size();
+                            state.order.push_back(d);
+                        }
+                    };
+
+                visit(state.source);
+                for (size_t i = 0; i < state.order.size(); ++i)
+                    visit(state.order[i]);
+
+                /* Every node that was found is a relaxation. */
+                LIBOCN_COUNT(relaxations, state.order.size());
+            }
+
+        /* Dijkstra's algorithm, for when the link costs differ.
+         * Stale heap entries are skipped when they're popped rather
+         * than being removed from the heap. */
+        void dijkstra_search(search_state& state) const
+            {
+                auto& heap = state.heap;
+                std::greater<std::pair<size_t, size_t>> cmp;
+                size_t pushes = 0;
+
+                heap.push_back(std::make_pair(0, state.source));
+                while (heap.size() != 0) {
+                    std::pop_heap(heap.begin(), heap.end(), cmp);
+                    auto top = heap.back(); heap.pop_back();
+
+                    auto n = top.second;
+                    if (top.first != state.cost[n])
+                        continue;
+                    if (n != state.source) {
+                        state.rank[n] = state.order.size();
+                        state.order.push_back(n);
+                    }
+
+                    for (size_t l = out_begin(n); l < out_end(n); ++l) {
+                        auto d = _out_dest[l];
+                        auto c = top.first + _out_cost[l];
+                        if ((state.cost[d] != npos) && (state.cost[d] <= c))
+                            continue;
+
+                        state.cost[d] = c;
+                        state.link[d] = l;
+                        heap.push_back(std::make_pair(c, d));
+                        std::push_heap(heap.begin(), heap.end(), cmp);
+                        pushes++;
+                    }
+                }
+
+                LIBOCN_COUNT(relaxations, pushes);
+                LIBOCN_COUNT(heap_pushes, pushes);
+            }
+    };
+
+    template<class node_t>
+    const size_t compiled_network<node_t>::npos;
+}
+
+#endif
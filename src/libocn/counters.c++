@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "counters.h++"
+#include <atomic>
+using namespace libocn;
+
+/* Whether or not the counters are compiled in is entirely up to this
+ * file, which is what lets every program share the same headers no
+ * matter how the library was built. */
+#ifdef LIBOCN_COUNTERS
+/* There's a single set of counters shared by every thread, which
+ * starts out zeroed as it's static. */
+static std::atomic<size_t> storage[counters::build_steps + 1];
+#endif
+
+bool counters::enabled(void)
+{
+#ifdef LIBOCN_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+counter_values counters::read(void)
+{
+    counter_values out;
+#ifdef LIBOCN_COUNTERS
+    out.relaxations = storage[relaxations].load();
+    out.heap_pushes = storage[heap_pushes].load();
+    out.paths_allocated = storage[paths_allocated].load();
+    out.bytes_read = storage[bytes_read].load();
+    out.build_steps = storage[build_steps].load();
+#else
+    out.relaxations = 0;
+    out.heap_pushes = 0;
+    out.paths_allocated = 0;
+    out.bytes_read = 0;
+    out.build_steps = 0;
+#endif
+    return out;
+}
+
+void counters::reset(void)
+{
+#ifdef LIBOCN_COUNTERS
+    for (auto& s: storage)
+        s = 0;
+#endif
+}
+
+void counters::add(enum id counter __attribute__((unused)),
+                   size_t n __attribute__((unused)))
+{
+#ifdef LIBOCN_COUNTERS
+    storage[counter].fetch_add(n, std::memory_order_relaxed);
+#endif
+}
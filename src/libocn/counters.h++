@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__COUNTERS_HXX
+#define LIBOCN__COUNTERS_HXX
+
+#include <stdlib.h>
+
+/* Event counters for the hot paths inside libocn.  Whether they're
+ * compiled in is decided when libocn itself is built (by defining
+ * LIBOCN_COUNTERS), not by the programs that use it: the code in
+ * these headers always calls into the library, which just throws the
+ * counts away when they're disabled.  "counters::enabled()" says
+ * which way the library was built.  The hot loops add up their
+ * counts locally and only call in once they're done, so that
+ * disabled counters don't cost anything measurable. */
+#define LIBOCN_COUNT(counter, n)                                        \
+    (libocn::counters::add(libocn::counters::counter, (n)))
+
+namespace libocn {
+    /* A snapshot of every counter. */
+    struct counter_values {
+        /* The number of times a search found a cheaper way to get
+         * to some node. */
+        size_t relaxations;
+
+        /* The number of entries pushed onto the heap by Dijkstra's
+         * algorithm. */
+        size_t heap_pushes;
+
+        /* The number of path objects that have been created, which
+         * includes the ones created by "path::cat()". */
+        size_t paths_allocated;
+
+        /* The number of bytes read from network files. */
+        size_t bytes_read;
+
+        /* The number of steps taken to wire up a network: one for
+         * every link a builder appends, one for every pair of nodes
+         * it looks at and skips, and one for every port probed while
+         * looking for a free one.  This should grow with the size of
+         * the network, not its square. */
+        size_t build_steps;
+    };
+
+    class counters {
+    public:
+        enum id {
+            relaxations,
+            heap_pushes,
+            paths_allocated,
+            bytes_read,
+            build_steps
+        };
+
+        /* Returns TRUE if libocn was built with counters. */
+        static bool enabled(void);
+
+        static counter_values read(void);
+        static void reset(void);
+
+        /* Adds to a single counter, which is what "LIBOCN_COUNT()"
+         * expands to. */
+        static void add(enum id counter, size_t n);
+    };
+}
+
+#endif
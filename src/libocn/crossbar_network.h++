@@ -22,9 +22,43 @@
 #ifndef LIBOCN__CROSSBAR_NETWORK_HXX
 #define LIBOCN__CROSSBAR_NETWORK_HXX
 
-#include "crossbar_network.h++"
+#include "network.h++"
+#include "node.h++"
+#include "routing_oracle.h++"
+#include "sizet_printf.h++"
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace libocn {
+    /* Every node in a crossbar is directly connected to every other
+     * node, so every route is a single hop. */
+    template<class node_t>
+    class crossbar_oracle : public routing_oracle<node_t> {
+        typedef std::shared_ptr<node_t> node_ptr;
+
+    public:
+        crossbar_oracle(const std::vector<node_ptr>& nodes)
+            : routing_oracle<node_t>(nodes)
+            {
+            }
+
+        virtual size_t distance(size_t s, size_t d) const
+            { return (s == d) ? 0 : 1; }
+
+        virtual size_t predecessor(size_t s, size_t d __attribute__((unused))) const
+            { return s; }
+
+        virtual size_t first_hop(size_t s __attribute__((unused)), size_t d) const
+            { return d; }
+
+        /* Every node links to all the others in order, skipping
+         * itself. */
+        virtual size_t port(size_t u, size_t v) const
+            { return (v < u) ? v : (v - 1); }
+    };
+
     /* This is the special sort of mesh network that exists on
      * DREAMER, which is essentially a mesh network that's offset by 1
      * in the X direction. */
@@ -37,8 +71,15 @@ namespace libocn {
         /* Creates a DREAMER mesh network of the given size. */
         crossbar_network(size_t count,
                       std::function<node_ptr(size_t)> f)
-            : network<node_t>(build_crossbar_network(count, f))
+            : network<node_t>(
+                [=](arena& links)
+                {
+                    return build_crossbar_network(links, count, f);
+                })
             {
+                this->set_oracle(
+                    std::make_shared<crossbar_oracle<node_t>>(this->nodes())
+                    );
             }
 
     public:
@@ -49,26 +90,32 @@ namespace libocn {
          * extra-special information in there if they need it. */
         static node_ptr create_node(size_t x)
             {
-                char buffer[BUFFER_SIZE];
-                snprintf(buffer, BUFFER_SIZE, SIZET_FORMAT, x);
-                return std::make_shared<node_t>(buffer);
+                return std::make_shared<node_t>(std::to_string(x));
             }
 
     private:
         /* This is pretty much just the constructor, I just want it
          * all created before I pass it up. */
         static std::vector<node_ptr>
-        build_crossbar_network(size_t count,
-                           std::function<node_ptr(size_t)> f)
+        build_crossbar_network(arena& links,
+                               size_t count,
+                               std::function<node_ptr(size_t)> f)
             {
                 std::vector<node_ptr> nodes;
+                nodes.reserve(count);
                 for (size_t i = 0; i < count; ++i)
                     nodes.push_back(f(i));
 
+                for (const auto& s: nodes)
+                    s->reserve_links(count - 1, count - 1);
+
+                /* The only pairs that get skipped are the nodes
+                 * themselves. */
                 for (const auto& s: nodes)
                     for (const auto& d: nodes)
-                        if (s->name() != d->name())
-                            s->add_path(std::make_shared<path_t>(s, d));
+                        if (s != d)
+                            s->append_link(network<node_t>::new_link(links, s, d));
+                LIBOCN_COUNT(build_steps, count);
 
                 return nodes;
             }
@@ -24,16 +24,279 @@
 
 #include "network.h++"
 #include "node.h++"
+#include "routing_oracle.h++"
 #include "sizet_printf.h++"
 #include <stdlib.h>
-#include <map>
 #include <functional>
-
-#ifndef BUFFER_SIZE
-#define BUFFER_SIZE 1024
-#endif
+#include <string>
+#include <vector>
 
 namespace libocn {
+    /* Computes route costs in a crossmesh.  Nodes are indexed row by
+     * row across the whole mesh, and every square block of "side" by
+     * "side" nodes is also fully connected as a crossbar.
+     *
+     * The cost of a route is the number of crossbar boundaries it
+     * crosses plus the number of crossbars in which it has to jump
+     * between two different nodes.  Routes never need to double
+     * back, so they cross exactly "DX + DY" boundaries (measured in
+     * crossbars) and pass through one more crossbar than that.
+     * A crossbar can be passed through without a jump only when the
+     * route enters and leaves at the same node, which can happen
+     *   - in the first crossbar, when the source already sits on the
+     *     edge it's leaving through,
+     *   - in the last crossbar, when the destination sits on the
+     *     edge the route enters through (and lines up with it), or
+     *   - in a crossbar where the route turns, when it enters and
+     *     leaves through the corner between those two edges.
+     * Two turns in a row can't both be jump-free, so each jump-free
+     * turn uses up one step in each direction: there can be at most
+     * "min(DX, DY)" of them.  Whether the first and last crossbars
+     * can also avoid a jump depends on what's left over.
+     *
+     * Routes are then found from the costs: every link costs 1, so
+     * the node before the destination (or after the source) is
+     * whichever neighbor is exactly one step closer.  Neighbors and
+     * ports are both worked out from the coordinates, so this never
+     * has to look at the nodes themselves. */
+    template<class node_t>
+    class crossmesh_oracle : public routing_oracle<node_t> {
+        typedef std::shared_ptr<node_t> node_ptr;
+
+    private:
+        size_t _width, _height, _side;
+
+    public:
+        crossmesh_oracle(const std::vector<node_ptr>& nodes,
+                         size_t x, size_t count)
+            : routing_oracle<node_t>(nodes),
+              _width(x * (size_t)(floor(sqrt(count)))),
+              _height(nodes.size() / _width),
+              _side((size_t)(floor(sqrt(count))))
+            {
+            }
+
+        /* Converts between indices and coordinates, where a node's
+         * position within its crossbar is numbered in row order. */
+        size_t x(size_t i) const { return i % _width; }
+        size_t y(size_t i) const { return i / _width; }
+        size_t position(size_t i) const
+            { return (y(i) % _side) * _side + (x(i) % _side); }
+
+        virtual size_t distance(size_t s, size_t d) const
+            {
+                if (s == d)
+                    return 0;
+
+                if (_side == 1)
+                    return this->span(x(s), x(d)) + this->span(y(s), y(d));
+
+                size_t dx = this->span(x(s) / _side, x(d) / _side);
+                size_t dy = this->span(y(s) / _side, y(d) / _side);
+                if ((dx == 0) && (dy == 0))
+                    return 1;
+
+                /* Flip everything around so the route always heads
+                 * towards increasing X and Y, at which point we only
+                 * care about the position of the end points within
+                 * their crossbars. */
+                auto sx = x(s) % _side, sy = y(s) % _side;
+                auto ex = x(d) % _side, ey = y(d) % _side;
+                if (x(d) < x(s)) {
+                    sx = _side - 1 - sx;
+                    ex = _side - 1 - ex;
+                }
+                if (y(d) < y(s)) {
+                    sy = _side - 1 - sy;
+                    ey = _side - 1 - ey;
+                }
+
+                auto crossings = dx + dy;
+                auto skipped = jumps_skipped(dx, dy, sx, sy, ex, ey);
+                return crossings + (crossings + 1 - skipped);
+            }
+
+        virtual size_t predecessor(size_t s, size_t d) const
+            {
+                auto c = distance(s, d);
+                return find_neighbor(d, [&](size_t u)
+                                     { return distance(s, u) + 1 == c; });
+            }
+
+        virtual size_t first_hop(size_t s, size_t d) const
+            {
+                auto c = distance(s, d);
+                return find_neighbor(s, [&](size_t v)
+                                     { return distance(v, d) + 1 == c; });
+            }
+
+        /* The crossmesh builder adds the mesh links first (in west,
+         * east, south, north order) and then the crossbar links in
+         * order of position, skipping the ones the mesh already
+         * added.  Each one takes the next free port. */
+        virtual size_t port(size_t u, size_t v) const
+            {
+                size_t p = 0;
+
+                if (x(u) > 0) {
+                    if (v == u - 1)
+                        return p;
+                    p++;
+                }
+                if (x(u) < _width - 1) {
+                    if (v == u + 1)
+                        return p;
+                    p++;
+                }
+                if (y(u) > 0) {
+                    if (v == u - _width)
+                        return p;
+                    p++;
+                }
+                if (y(u) < _height - 1) {
+                    if (v == u + _width)
+                        return p;
+                    p++;
+                }
+
+                /* Everything in the crossbar before "v" takes a port,
+                 * other than "u" itself and its mesh neighbors. */
+                auto a = position(u), b = position(v);
+                p += b;
+                if (a < b)
+                    p--;
+                if ((a % _side > 0) && (a - 1 < b))
+                    p--;
+                if ((a % _side < _side - 1) && (a + 1 < b))
+                    p--;
+                if ((a >= _side) && (a - _side < b))
+                    p--;
+                if ((a + _side < _side * _side) && (a + _side < b))
+                    p--;
+                return p;
+            }
+
+    private:
+        /* Returns the first neighbor of "i" for which "f" is TRUE,
+         * checking the mesh neighbors first and then the rest of the
+         * crossbar. */
+        template<class F>
+        size_t find_neighbor(size_t i, F f) const
+            {
+                if ((x(i) > 0) && f(i - 1))
+                    return i - 1;
+                if ((x(i) < _width - 1) && f(i + 1))
+                    return i + 1;
+                if ((y(i) > 0) && f(i - _width))
+                    return i - _width;
+                if ((y(i) < _height - 1) && f(i + _width))
+                    return i + _width;
+
+                auto bx = x(i) - x(i) % _side;
+                auto by = y(i) - y(i) % _side;
+                for (size_t c = 0; c < _side * _side; ++c) {
+                    auto j = (by + c / _side) * _width + bx + c % _side;
+                    if ((j != i) && f(j))
+                        return j;
+                }
+
+                fprintf(stderr, "No route through '%s'\n",
+                        this->at(i)->name().c_str());
+                abort();
+                return this->npos;
+            }
+
+        /* Returns the largest number of crossbars that a route can
+         * pass through without jumping, for a route that heads
+         * towards increasing X and Y. */
+        size_t jumps_skipped(size_t dx, size_t dy,
+                             size_t sx, size_t sy,
+                             size_t ex, size_t ey) const
+            {
+                /* Whether the first crossbar can be left without a
+                 * jump by a step in X or Y, and the same for
+                 * entering the last crossbar. */
+                bool first[2] = { (dx > 0) && (sx == _side - 1),
+                                  (dy > 0) && (sy == _side - 1) };
+                bool last[2] = { (dx > 0) && (ex == 0),
+                                 (dy > 0) && (ey == 0) };
+
+                /* When the route only goes in one direction there
+                 * are no turns, so only the ends can skip a jump.
+                 * If there's only a single crossing then the two
+                 * ends must also line up. */
+                if ((dx == 0) || (dy == 0)) {
+                    size_t d = (dx > 0) ? 0 : 1;
+                    bool aligned = (d == 0) ? (sy == ey) : (sx == ex);
+
+                    if (first[d] && last[d] && (dx + dy == 1) && !aligned)
+                        return 1;
+                    return (first[d] ? 1 : 0) + (last[d] ? 1 : 0);
+                }
+
+                /* Otherwise every jump-free turn uses up a step in
+                 * each direction, which leaves some single steps
+                 * over.  An end can skip its jump either by being
+                 * next to a jump-free turn (which requires the end
+                 * point to be in the corner), or by starting (or
+                 * finishing) with one of the leftover single steps
+                 * in a direction it can leave (or enter) without a
+                 * jump.  Giving up one turn leaves two more single
+                 * steps to use at the ends, so that's tried too. */
+                bool first_corner = first[0] && first[1];
+                bool last_corner = last[0] && last[1];
+                size_t n = std::min(dx, dy);
+                size_t best = 0;
+
+                for (size_t broken = 0; (broken <= 1) && (broken <= n); ++broken) {
+                    size_t turns = n - broken;
+                    size_t spare[2] = { broken, broken };
+                    if (dx > dy)
+                        spare[0] += dx - dy;
+                    else
+                        spare[1] += dy - dx;
+
+                    /* Each end either doesn't skip its jump (0),
+                     * skips it using a turn (1), or skips it by
+                     * stepping in X (2) or Y (3). */
+                    for (size_t f = 0; f < 4; ++f) {
+                        for (size_t l = 0; l < 4; ++l) {
+                            if ((f == 1) && !first_corner)
+                                continue;
+                            if ((l == 1) && !last_corner)
+                                continue;
+                            if ((f >= 2) && !first[f - 2])
+                                continue;
+                            if ((l >= 2) && !last[l - 2])
+                                continue;
+
+                            /* A route that's just a single turn can
+                             * use that turn at both ends. */
+                            size_t corners = (f == 1 ? 1 : 0) + (l == 1 ? 1 : 0);
+                            bool shared = (turns == 1) && (dx + dy == 2);
+                            if ((corners > turns) && !shared)
+                                continue;
+
+                            size_t used[2] = { 0, 0 };
+                            if (f >= 2)
+                                used[f - 2]++;
+                            if (l >= 2)
+                                used[l - 2]++;
+                            if ((used[0] > spare[0]) || (used[1] > spare[1]))
+                                continue;
+
+                            auto skipped = turns
+                                + (f != 0 ? 1 : 0)
+                                + (l != 0 ? 1 : 0);
+                            best = std::max(best, skipped);
+                        }
+                    }
+                }
+
+                return best;
+            }
+    };
+
     /* This is a special sort of network that allows for the creation
      * of a crossmesh network.  The idea is that the user doesn't need to
      * specify a network configuration file but can instead simply
@@ -52,8 +315,16 @@ namespace libocn {
          * below. */
         crossmesh_network(size_t x, size_t y, size_t count,
                       std::function<node_ptr(size_t, size_t, size_t)> f)
-            : network<node_t>(build_crossmesh_network(x, y, count, f))
+            : network<node_t>(
+                [=](arena& links)
+                {
+                    return build_crossmesh_network(links, x, y, count, f);
+                })
             {
+                this->set_oracle(
+                    std::make_shared<crossmesh_oracle<node_t>>(this->nodes(),
+                                                               x, count)
+                    );
             }
 
     public:
@@ -64,16 +335,18 @@ namespace libocn {
          * extra-special information in there if they need it. */
         static node_ptr create_node(size_t x, size_t y, size_t b)
             {
-                char buffer[BUFFER_SIZE];
-                snprintf(buffer, BUFFER_SIZE, "(" SIZET_FORMAT "," SIZET_FORMAT ")." SIZET_FORMAT, x, y, b);
-                return std::make_shared<node_t>(buffer);
+                return std::make_shared<node_t>(
+                    "(" + std::to_string(x) + "," + std::to_string(y) + ")."
+                    + std::to_string(b)
+                    );
             }
 
     private:
         /* This is effectively the constructor, the actual constructor
          * functions are just wrappers for this. */
         static std::vector<node_ptr>
-        build_crossmesh_network(size_t X, size_t Y, size_t count,
+        build_crossmesh_network(arena& links,
+                                size_t X, size_t Y, size_t count,
                             std::function<node_ptr(size_t, size_t, size_t)> f)
             {
                 size_t side = floor(sqrt(count));
@@ -82,88 +355,80 @@ namespace libocn {
                     abort();
                 }
 
-                std::vector<node_ptr> out;
-                std::map<std::pair<size_t, size_t>, node_ptr> grid;
-                std::map<std::pair<size_t, size_t>, size_t> cbc;
-                std::multimap<std::pair<size_t, size_t>, node_ptr> cb;
-
                 /* First just make every node so we can reference them
-                 * later. */
-                for (size_t y = 0; y < Y * side; ++y) {
-                    for (size_t x = 0; x < X * side; ++x) {
-                        auto cx = x / side;
-                        auto cy = y / side;
-                        if (cbc.find(std::make_pair(cx, cy)) == cbc.end())
-                            cbc[std::make_pair(cx, cy)] = 0;
-                        auto c = cbc.find(std::make_pair(cx, cy))->second;
-
-                        auto n = f(cx, cy, c);
-                        out.push_back(n);
-                        grid[std::make_pair(x, y)] = n;
-                        cb.insert(std::make_pair(std::make_pair(cx, cy), n));
-
-                        c++;
-                        cbc[std::make_pair(cx, cy)] = c;
+                 * later.  The list is in row order, so it doubles as
+                 * the grid.  Nodes are numbered within their crossbar
+                 * in the order they're created, which is also row
+                 * order. */
+                size_t width = X * side;
+                size_t height = Y * side;
+                std::vector<node_ptr> out;
+                out.reserve(width * height);
+                for (size_t y = 0; y < height; ++y) {
+                    for (size_t x = 0; x < width; ++x) {
+                        auto c = (y % side) * side + (x % side);
+                        out.push_back(f(x / side, y / side, c));
                     }
                 }
 
+                auto at = [&](size_t x, size_t y) -> const node_ptr&
+                    { return out[y * width + x]; };
+
+                for (const auto& n: out)
+                    n->reserve_links(count + 3, count + 3);
+
                 /* Now build a mesh network, the crossmesh is strictly
                  * more connected than the mesh is. */
-                for (size_t y = 0; y < Y * side; ++y) {
-                    for (size_t x = 0; x < X * side; ++x) {
+                for (size_t y = 0; y < height; ++y) {
+                    for (size_t x = 0; x < width; ++x) {
+                        auto& s = at(x, y);
                         if (x > 0)
-                            add_map(grid, x, y, x-1, y+0);
-                        if (x < (X*side)-1)
-                            add_map(grid, x, y, x+1, y+0);
+                            connect(links, s, at(x-1, y+0));
+                        if (x < width-1)
+                            connect(links, s, at(x+1, y+0));
                         if (y > 0)
-                            add_map(grid, x, y, x+0, y-1);
-                        if (y < (Y*side)-1)
-                            add_map(grid, x, y, x+0, y+1);
+                            connect(links, s, at(x+0, y-1));
+                        if (y < height-1)
+                            connect(links, s, at(x+0, y+1));
                     }
                 }
 
-                /* Now link the internal nodes with crossbars. */
-                for (const auto& ap: cb) {
-                    for (const auto& bp: cb) {
-                        if (ap.first != bp.first)
-                            continue;
-
-                        auto a = ap.second;
-                        auto b = bp.second;
+                /* Now link the internal nodes with crossbars, which
+                 * only has to look at the pairs within each crossbar.
+                 * Pairs that are next to each other already got a
+                 * link from the mesh. */
+                size_t skipped = 0;
+                for (size_t cx = 0; cx < X; ++cx) {
+                    for (size_t cy = 0; cy < Y; ++cy) {
+                        for (size_t a = 0; a < count; ++a) {
+                            auto ax = cx * side + a % side;
+                            auto ay = cy * side + a / side;
 
-                        if (a->name() == b->name())
-                            continue;
+                            for (size_t b = 0; b < count; ++b) {
+                                auto bx = cx * side + b % side;
+                                auto by = cy * side + b / side;
 
-                        if (a->is_neighbor(b) == true)
-                            continue;
+                                auto dx = (ax > bx) ? ax - bx : bx - ax;
+                                auto dy = (ay > by) ? ay - by : by - ay;
+                                if ((a == b) || (dx + dy == 1)) {
+                                    skipped++;
+                                    continue;
+                                }
 
-                        auto path = std::make_shared<path_t>(a, b);
-                        a->add_path(path);
+                                connect(links, at(ax, ay), at(bx, by));
+                            }
+                        }
                     }
                 }
+                LIBOCN_COUNT(build_steps, skipped);
 
                 return out;
             }
 
-        static
-        void add_map(std::map<std::pair<size_t, size_t>, node_ptr>& grid,
-                     size_t sx, size_t sy, size_t dx, size_t dy)
+        static void connect(arena& links,
+                            const node_ptr& s, const node_ptr& d)
             {
-                auto source_l = grid.find(std::make_pair(sx, sy));
-                if (source_l == grid.end()) {
-                    fprintf(stderr, "Unmapped source (" SIZET_FORMAT "," SIZET_FORMAT ")\n", sx, sy);
-                    abort();
-                }
-                auto source = source_l->second;
-
-                auto dest_l = grid.find(std::make_pair(dx, dy));
-                if (dest_l == grid.end()) {
-                    fprintf(stderr, "Unmapped dest (" SIZET_FORMAT "," SIZET_FORMAT ")\n", dx, dy);
-                    abort();
-                }
-                auto dest = dest_l->second;
-
-                source->add_path(std::make_shared<path_t>(source, dest));
+                s->append_link(network<node_t>::new_link(links, s, d));
             }
     };
 }
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "mapped_file.h++"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace libocn;
+
+mapped_file::mapped_file(const std::string& path)
+    : _data(NULL),
+      _size(0),
+      _mapped(false)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to open '%s': %s\n",
+                path.c_str(), strerror(errno));
+        abort();
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Unable to stat '%s': %s\n",
+                path.c_str(), strerror(errno));
+        abort();
+    }
+
+    if (S_ISREG(st.st_mode) == false) {
+        read_all(fd, path);
+        close(fd);
+        return;
+    }
+
+    /* mmap() refuses to map nothing, but an empty file is still a
+     * valid (if boring) network. */
+    _size = st.st_size;
+    if (_size == 0) {
+        close(fd);
+        return;
+    }
+
+    void *data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Unable to map '%s': %s\n",
+                path.c_str(), strerror(errno));
+        abort();
+    }
+
+    /* The mapping sticks around after the descriptor is closed.  The
+     * whole file is about to be read from front to back. */
+    close(fd);
+    madvise(data, _size, MADV_SEQUENTIAL);
+    _data = (const char *)data;
+    _mapped = true;
+}
+
+mapped_file::~mapped_file(void)
+{
+    if (_mapped == true)
+        munmap((void *)_data, _size);
+    else
+        free((void *)_data);
+}
+
+void mapped_file::read_all(int fd, const std::string& path)
+{
+    size_t capacity = 0;
+    char *data = NULL;
+
+    while (true) {
+        if (_size == capacity) {
+            capacity = (capacity == 0) ? 4096 : capacity * 2;
+            data = (char *)realloc(data, capacity);
+            if (data == NULL) {
+                fprintf(stderr, "Unable to read '%s': out of memory\n",
+                        path.c_str());
+                abort();
+            }
+        }
+
+        ssize_t got = read(fd, data + _size, capacity - _size);
+        if ((got < 0) && (errno == EINTR))
+            continue;
+        if (got < 0) {
+            fprintf(stderr, "Unable to read '%s': %s\n",
+                    path.c_str(), strerror(errno));
+            abort();
+        }
+        if (got == 0)
+            break;
+
+        _size += got;
+    }
+
+    _data = data;
+}
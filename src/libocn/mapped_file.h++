@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__MAPPED_FILE_HXX
+#define LIBOCN__MAPPED_FILE_HXX
+
+#include <stdlib.h>
+#include <string>
+
+namespace libocn {
+    /* A read-only view of an entire file.  The file is mapped into
+     * memory rather than read, so even very large network files
+     * don't need to be copied before they're parsed.  Things that
+     * can't be mapped (like pipes) are just read in instead.  Failing
+     * to open the file is fatal. */
+    class mapped_file {
+    private:
+        const char *_data;
+        size_t _size;
+        bool _mapped;
+
+    public:
+        mapped_file(const std::string& path);
+        ~mapped_file(void);
+
+        /* There's no sense in copying one of these around. */
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        /* The contents of the file, which aren't NUL-terminated. */
+        const char *data(void) const { return _data; }
+        size_t size(void) const { return _size; }
+
+    private:
+        void read_all(int fd, const std::string& path);
+    };
+}
+
+#endif
@@ -24,16 +24,92 @@
 
 #include "network.h++"
 #include "node.h++"
+#include "routing_oracle.h++"
 #include "sizet_printf.h++"
 #include <stdlib.h>
-#include <map>
 #include <functional>
-
-#ifndef BUFFER_SIZE
-#define BUFFER_SIZE 1024
-#endif
+#include <string>
+#include <vector>
 
 namespace libocn {
+    /* Routes packets through a mesh using dimension-order routing:
+     * first along X until the column matches, then along Y.  Nodes
+     * are indexed in the order the mesh builder creates them, which
+     * is row by row. */
+    template<class node_t>
+    class mesh_oracle : public routing_oracle<node_t> {
+        typedef std::shared_ptr<node_t> node_ptr;
+
+    private:
+        size_t _x_min, _x_max, _y_min, _y_max;
+
+    public:
+        mesh_oracle(const std::vector<node_ptr>& nodes,
+                    size_t x_min, size_t x_max,
+                    size_t y_min, size_t y_max)
+            : routing_oracle<node_t>(nodes),
+              _x_min(x_min),
+              _x_max(x_max),
+              _y_min(y_min),
+              _y_max(y_max)
+            {
+            }
+
+        /* Converts between indices and coordinates. */
+        size_t x(size_t i) const { return _x_min + i % width(); }
+        size_t y(size_t i) const { return _y_min + i / width(); }
+        size_t at(size_t x, size_t y) const
+            { return (y - _y_min) * width() + (x - _x_min); }
+        size_t width(void) const { return _x_max - _x_min + 1; }
+
+        virtual size_t distance(size_t s, size_t d) const
+            {
+                return this->span(x(s), x(d)) + this->span(y(s), y(d));
+            }
+
+        /* Routes go along X first, so the last hop is along Y unless
+         * the two nodes are in the same row. */
+        virtual size_t predecessor(size_t s, size_t d) const
+            {
+                if (y(d) != y(s))
+                    return at(x(d), this->toward(y(d), y(s)));
+                return at(this->toward(x(d), x(s)), y(d));
+            }
+
+        virtual size_t first_hop(size_t s, size_t d) const
+            {
+                if (x(d) != x(s))
+                    return at(this->toward(x(s), x(d)), y(s));
+                return at(x(s), this->toward(y(s), y(d)));
+            }
+
+        /* The mesh builder adds links in west, east, south, north
+         * order and each one takes the next free port, so the port
+         * number is just the number of those links that come before
+         * the one we want. */
+        virtual size_t port(size_t u, size_t v) const
+            {
+                size_t p = 0;
+
+                if (x(v) < x(u))
+                    return p;
+                if (x(u) > _x_min)
+                    p++;
+
+                if (x(v) > x(u))
+                    return p;
+                if (x(u) < _x_max)
+                    p++;
+
+                if (y(v) < y(u))
+                    return p;
+                if (y(u) > _y_min)
+                    p++;
+
+                return p;
+            }
+    };
+
     /* This is a special sort of network that allows for the creation
      * of a mesh network.  The idea is that the user doesn't need to
      * specify a network configuration file but can instead simply
@@ -53,13 +129,18 @@ namespace libocn {
                      size_t y_min, size_t y_max,
                      std::function<node_ptr(size_t, size_t)> f
             )
-            : network<node_t>(build_mesh_network(x_min,
-                                                 x_max,
-                                                 y_min,
-                                                 y_max,
-                                                 f)
-                )
+            : network<node_t>(
+                [=](arena& links)
+                {
+                    return build_mesh_network(links, x_min, x_max,
+                                              y_min, y_max, f);
+                })
             {
+                this->set_oracle(
+                    std::make_shared<mesh_oracle<node_t>>(this->nodes(),
+                                                          x_min, x_max,
+                                                          y_min, y_max)
+                    );
             }
 
         /* This is exactly the same as calling "mesh_network(0, xc, 0,
@@ -67,13 +148,18 @@ namespace libocn {
         mesh_network(size_t x_count, size_t y_count,
                      std::function<node_ptr(size_t, size_t)> f
             )
-            : network<node_t>(build_mesh_network(0,
-                                                 x_count - 1,
-                                                 0,
-                                                 y_count - 1,
-                                                 f)
-                )
+            : network<node_t>(
+                [=](arena& links)
+                {
+                    return build_mesh_network(links, 0, x_count - 1,
+                                              0, y_count - 1, f);
+                })
             {
+                this->set_oracle(
+                    std::make_shared<mesh_oracle<node_t>>(this->nodes(),
+                                                          0, x_count - 1,
+                                                          0, y_count - 1)
+                    );
             }
 
     public:
@@ -84,74 +170,63 @@ namespace libocn {
          * extra-special information in there if they need it. */
         static node_ptr create_node(size_t x, size_t y)
             {
-                char buffer[BUFFER_SIZE];
-                snprintf(buffer, BUFFER_SIZE, "(" SIZET_FORMAT ", " SIZET_FORMAT ")", x, y);
-                return std::make_shared<node_t>(buffer);
+                return std::make_shared<node_t>(
+                    "(" + std::to_string(x) + ", " + std::to_string(y) + ")"
+                    );
             }
 
     private:
         /* This is effectively the constructor, the actual constructor
          * functions are just wrappers for this. */
         static std::vector<node_ptr>
-        build_mesh_network(size_t x_min, size_t x_max,
+        build_mesh_network(arena& links,
+                           size_t x_min, size_t x_max,
                            size_t y_min, size_t y_max,
                            std::function<node_ptr(size_t, size_t)> f)
             {
+                /* First we just build a big list of every node in the
+                 * system.  That list doubles as the grid: it's in row
+                 * order, so the node at any position can be found
+                 * directly. */
+                size_t width = x_max - x_min + 1;
+                size_t height = y_max - y_min + 1;
                 std::vector<node_ptr> out;
-                std::map<std::pair<size_t, size_t>, node_ptr> grid;
+                out.reserve(width * height);
+                for (size_t y = y_min; y <= y_max; ++y)
+                    for (size_t x = x_min; x <= x_max; ++x)
+                        out.push_back(f(x, y));
 
-                /* First we just build a big list of every node in the
-                 * system.  There's two accounting structures that get
-                 * created: a vector of all nodes, and a map that
-                 * allows me to quickly look up a node based on its
-                 * position. */
-                for (size_t y = y_min; y <= y_max; ++y) {
-                    for (size_t x = x_min; x <= x_max; ++x) {
-                        auto n = f(x, y);
-                        out.push_back(n);
-                        grid[std::make_pair(x, y)] = n;
-                    }
-                }
+                auto at = [&](size_t x, size_t y) -> const node_ptr&
+                    { return out[(y - y_min) * width + (x - x_min)]; };
+
+                for (const auto& n: out)
+                    n->reserve_links(4, 4);
 
                 /* Now that every node has been created we want to
-                 * fill out the trivially-known routes. */
+                 * fill out the trivially-known routes.  Ports are
+                 * handed out in the order links are added, so this
+                 * order is what the mesh oracle expects. */
                 for (size_t x = x_min; x <= x_max; ++x) {
                     for (size_t y = y_min; y <= y_max; ++y) {
+                        auto& s = at(x, y);
                         if (x > x_min)
-                            add_map(out, grid, x, y, x-1, y+0);
+                            connect(links, s, at(x-1, y+0));
                         if (x < x_max)
-                            add_map(out, grid, x, y, x+1, y+0);
+                            connect(links, s, at(x+1, y+0));
                         if (y > y_min)
-                            add_map(out, grid, x, y, x+0, y-1);
+                            connect(links, s, at(x+0, y-1));
                         if (y < y_max)
-                            add_map(out, grid, x, y, x+0, y+1);
+                            connect(links, s, at(x+0, y+1));
                     }
                 }
 
                 return out;
             }
 
-        static
-        void add_map(std::vector<node_ptr>& out __attribute__((unused)),
-                     std::map<std::pair<size_t, size_t>,
-                              node_ptr>& grid,
-                     size_t sx, size_t sy, size_t dx, size_t dy)
+        static void connect(arena& links,
+                            const node_ptr& s, const node_ptr& d)
             {
-                auto source_l = grid.find(std::make_pair(sx, sy));
-                if (source_l == grid.end()) {
-                    fprintf(stderr, "Unmapped source (" SIZET_FORMAT "," SIZET_FORMAT ")\n", sx, sy);
-                    abort();
-                }
-                auto source = source_l->second;
-
-                auto dest_l = grid.find(std::make_pair(dx, dy));
-                if (dest_l == grid.end()) {
-                    fprintf(stderr, "Unmapped dest (" SIZET_FORMAT "," SIZET_FORMAT ")\n", dx, dy);
-                    abort();
-                }
-                auto dest = dest_l->second;
-
-                source->add_path(std::make_shared<path_t>(source, dest));
+                s->append_link(network<node_t>::new_link(links, s, d));
             }
     };
 }
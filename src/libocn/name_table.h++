@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__NAME_TABLE_HXX
+#define LIBOCN__NAME_TABLE_HXX
+
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libocn {
+    /* Maps node names to their index in a list of nodes.  Names
+     * aren't copied in here: the table only stores indices and
+     * compares against the names that the nodes already have, so
+     * every name is stored exactly once.  Lookups take a pointer and
+     * a length, which lets the parser look up names straight out of
+     * the file.  The node list is passed in to every call rather
+     * than being kept around, as it's owned by whoever owns the
+     * table. */
+    template<class node_t>
+    class name_table {
+        typedef std::shared_ptr<node_t> node_ptr;
+
+    public:
+        /* Returned when a name isn't in the table. */
+        static const size_t npos = (size_t)(-1);
+
+    private:
+        /* This is an open-addressed hash table of node indices,
+         * which is always a power of 2 in size and never more than
+         * half full. */
+        std::vector<size_t> _slots;
+        size_t _count;
+
+    public:
+        name_table(void)
+            : _slots(),
+              _count(0)
+            {
+            }
+
+        /* Returns the index of the node with the given name, or
+         * "npos" if there isn't one. */
+        size_t find(const std::vector<node_ptr>& nodes,
+                    const char *name, size_t length) const
+            {
+                if (_slots.size() == 0)
+                    return npos;
+                return _slots[probe(nodes, name, length)];
+            }
+
+        size_t find(const std::vector<node_ptr>& nodes,
+                    const std::string& name) const
+            {
+                return find(nodes, name.c_str(), name.size());
+            }
+
+        /* Adds the node at index "i" to the table, returning FALSE
+         * if there's already a node with that name. */
+        bool insert(const std::vector<node_ptr>& nodes, size_t i)
+            {
+                if (2 * (_count + 1) > _slots.size())
+                    grow(nodes);
+
+                const auto& name = nodes[i]->name();
+                auto slot = probe(nodes, name.c_str(), name.size());
+                if (_slots[slot] != npos)
+                    return false;
+
+                _slots[slot] = i;
+                _count++;
+                return true;
+            }
+
+    private:
+        /* Finds the slot that either holds the given name or is
+         * where it would go. */
+        size_t probe(const std::vector<node_ptr>& nodes,
+                     const char *name, size_t length) const
+            {
+                auto mask = _slots.size() - 1;
+                for (auto slot = hash(name, length) & mask;;
+                     slot = (slot + 1) & mask) {
+                    auto i = _slots[slot];
+                    if (i == npos)
+                        return slot;
+
+                    const auto& that = nodes[i]->name();
+                    if ((that.size() == length) &&
+                        (memcmp(that.data(), name, length) == 0))
+                        return slot;
+                }
+            }
+
+        void grow(const std::vector<node_ptr>& nodes)
+            {
+                std::vector<size_t> old;
+                old.swap(_slots);
+                _slots.assign((old.size() == 0) ? 16 : 2 * old.size(), npos);
+                for (const auto& i: old) {
+                    if (i == npos)
+                        continue;
+
+                    const auto& name = nodes[i]->name();
+                    _slots[probe(nodes, name.c_str(), name.size())] = i;
+                }
+            }
+
+        /* FNV-1a, which is plenty for node names. */
+        static size_t hash(const char *name, size_t length)
+            {
+                uint64_t h = 14695981039346656037ULL;
+                for (size_t i = 0; i < length; ++i) {
+                    h ^= (unsigned char)name[i];
+                    h *= 1099511628211ULL;
+                }
+                return (size_t)h;
+            }
+    };
+
+    template<class node_t>
+    const size_t name_table<node_t>::npos;
+}
+
+#endif
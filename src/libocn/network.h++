@@ -24,190 +24,809 @@
 
 #include "node.h++"
 #include "path.h++"
+#include "arena.h++"
+#include "compiled_network.h++"
+#include "counters.h++"
+#include "mapped_file.h++"
+#include "name_table.h++"
+#include "routing_oracle.h++"
+#include "snapshot.h++"
+#include "thread_pool.h++"
+#include "sizet_printf.h++"
+#include <errno.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <unordered_map>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
-#ifndef BUFFER_SIZE
-#define BUFFER_SIZE 1024
-#endif
-
 namespace libocn {
     /* This is the top-level OCN class: it stores a single network.
      * Note that while there's a lot of shared pointers inside here I
      * need to use some weak pointers to avoid circular references
      * between nodes -- essentially what this means is that if you're
      * doing any computation on the network you want to keep around a
-     * reference to that network. */
+     * reference to that network.  The direct links that the network
+     * creates itself are allocated from the network's arena, and are
+     * taken away from the nodes when the network goes away. */
     template<class node_t> class network {
     protected:
         typedef std::shared_ptr<node_t> node_ptr;
         typedef path<node_t> path_t;
+        typedef compiled_network<node_t> compiled_t;
+        typedef routing_oracle<node_t> oracle_t;
+
+        /* Builds the nodes of a network, allocating the links
+         * between them from the given arena. */
+        typedef std::function<
+            std::vector<node_ptr>(arena&)
+            > builder_t;
 
     private:
-        /* This stores the list of every node in the network. */
+        /* The direct links between nodes are allocated from here,
+         * rather than each being its own heap object.  Every link
+         * holds a reference to the arena, so it sticks around for as
+         * long as any of them do.  This has to come before the node
+         * list, as it's used to build it. */
+        std::shared_ptr<arena> _arena;
+
+        /* This stores the list of every node in the network, which
+         * is indexed by UID, along with a table to find them by
+         * name. */
         std::vector<node_ptr> _node_list;
-        std::unordered_map<std::string, node_ptr> _nodes;
-        std::map< std::pair<size_t, size_t>, node_ptr > _grid;
+        name_table<node_t> _names;
+
+        /* The nodes are laid out on a grid of this width, in the
+         * same order as the node list. */
+        size_t _grid_width;
+
+        /* Regular topologies can provide an oracle that computes
+         * routes without searching, this is NULL otherwise. */
+        std::shared_ptr<oracle_t> _oracle;
+
+        /* Counts the number of distinct sources whose routes have
+         * had to be recomputed because a link changed, along with
+         * which sources (by UID) those are. */
+        size_t _routes_recomputed;
+        std::vector<bool> _recomputed;
 
     public:
         /* This constructor will probably only be useful if you're a
          * subclass of a network that aims to avoid parsing
-         * configuration files. */
+         * configuration files.  A node's UID is its index in the
+         * network, so a node can only be part of one network at a
+         * time: passing in a node that's still part of some other
+         * network aborts.  Nodes become free to join another network
+         * once theirs is destroyed, which also drops the links and
+         * routes the network created for them (see "~network()"). */
         network(const std::vector<node_ptr>& nodes)
-            : _node_list(nodes),
-              _nodes(build_name_map(nodes)),
-              _grid(build_grid(nodes))
+            : _arena(std::make_shared<arena>()),
+              _node_list(nodes),
+              _names(),
+              _grid_width(grid_width(nodes.size())),
+              _oracle(),
+              _routes_recomputed(0),
+              _recomputed()
             {
+                adopt(_node_list);
+                index_names();
             }
 
         /* This constructor reads a file to produce a list of nodes
-         * along with their neighbors. */
+         * along with their neighbors.  The file can either be in the
+         * text format (which is what "ocn-neighbors" prints out) or
+         * be a binary snapshot written by "write_snapshot()". */
         network(const std::string& filename,
                 std::function<node_ptr(std::string)> f)
-            : _node_list(read_file(filename, f)),
-              _nodes(build_name_map(_node_list)),
-              _grid(build_grid(_node_list))
+            : _arena(std::make_shared<arena>()),
+              _node_list(read_file(filename, f, *_arena)),
+              _names(),
+              _grid_width(grid_width(_node_list.size())),
+              _oracle(),
+              _routes_recomputed(0),
+              _recomputed()
             {
+                index_names();
             }
 
+        /* Drops the links that this network created (the ones that
+         * live in its arena) from the nodes, along with every route,
+         * which leaves the nodes free to be part of some other
+         * network.  Links that were added to the nodes directly are
+         * left alone.  Anything else that's still holding onto one
+         * of the dropped links (or a frozen view) keeps working, as
+         * it keeps the arena alive. */
+        ~network(void)
+            {
+                for (const auto& n: _node_list)
+                    n->release(*_arena);
+            }
+
+        /* Copies would share both the nodes and the arena, so
+         * there's no sensible way to make one. */
+        network(const network&) = delete;
+        network& operator=(const network&) = delete;
+
         /* Returns a list that contains every node in this network. */
         std::vector<node_ptr> nodes(void) const { return _node_list; }
 
+        /* Produces a frozen view of this network, where every node
+         * is given a dense index (in the same order as "nodes()")
+         * and the links are packed into flat arrays. */
+        std::shared_ptr<compiled_t> freeze(void) const
+            {
+                return std::make_shared<compiled_t>(_node_list);
+            }
+
+        /* Computes the shortest paths between every pair of nodes in
+         * the network, spreading the sources out over the given
+         * number of threads (0 means one per hardware thread).
+         * Afterwards every node already knows its paths, so calls to
+         * "node::paths()" and "node::search()" won't need to search
+         * the graph. */
+        void compute_all_paths(size_t threads = 1)
+            {
+                thread_pool pool(threads);
+
+                /* Networks with an oracle don't need to search at
+                 * all. */
+                if (_oracle != NULL) {
+                    auto oracle = _oracle;
+                    pool.run(oracle->size(),
+                             [&](size_t worker __attribute__((unused)),
+                                 size_t source)
+                             {
+                                 oracle->install(source);
+                             });
+                    return;
+                }
+
+                auto frozen = freeze();
+
+                std::vector<typename compiled_t::search_state>
+                    states(pool.size());
+                pool.run(frozen->size(),
+                         [&](size_t worker, size_t source)
+                         {
+                             auto& state = states[worker];
+                             frozen->search(source, state);
+                             frozen->install(state);
+                         });
+            }
+
+        /* These change the links in the network while keeping the
+         * routes that have already been computed up to date.  Only
+         * the sources that actually route over a changed link (or
+         * could get cheaper routes from a new one) do any work, and
+         * they only recompute the part of their tree that's below
+         * the change.  Adding a link that already exists and
+         * removing or re-weighting one that doesn't are errors. */
+        void add_link(const node_ptr& s, const node_ptr& d, size_t cost = 1)
+            {
+                if (s->find_link(d) != NULL) {
+                    fprintf(stderr, "Link from '%s' to '%s' already exists\n",
+                            s->name().c_str(), d->name().c_str());
+                    abort();
+                }
+
+                auto link = new_link(*_arena, s, d, cost);
+                s->add_link(link);
+                update_routes(s, d, NULL, link);
+            }
+
+        void remove_link(const node_ptr& s, const node_ptr& d)
+            {
+                auto link = s->remove_link(d);
+                if (link == NULL)
+                    missing_link(s, d);
+
+                update_routes(s, d, link, NULL);
+            }
+
+        void set_link_cost(const node_ptr& s, const node_ptr& d, size_t cost)
+            {
+                auto old_link = s->find_link(d);
+                if (old_link == NULL)
+                    missing_link(s, d);
+                if (old_link->cost() == cost)
+                    return;
+
+                auto link = s->set_link_cost(d, cost);
+                update_routes(s, d, old_link, link);
+            }
+
+        /* Returns the number of distinct sources that have had to
+         * recompute (part of) their routes because of calls to the
+         * functions above.  A source that's affected by several
+         * changes is only counted once. */
+        size_t routes_recomputed(void) const { return _routes_recomputed; }
+
+        /* Writes out a binary snapshot of this network, which can be
+         * loaded back in far faster than the text format can be
+         * parsed.  When "routes" is set the shortest-path tree of
+         * every node is saved as well (computing it first if
+         * necessary), so the loaded network won't have to search at
+         * all. */
+        void write_snapshot(const std::string& path, bool routes = false) const
+            {
+                FILE *f = fopen(path.c_str(), "w");
+                if (f == NULL) {
+                    fprintf(stderr, "Unable to open '%s': %s\n",
+                            path.c_str(), strerror(errno));
+                    abort();
+                }
+
+                /* Every section is padded out to 8 bytes, so they can
+                 * all be read in place. */
+                auto write = [&](const void *data, size_t bytes)
+                    {
+                        static const char padding[8] = {0};
+                        if ((fwrite(data, 1, bytes, f) != bytes) ||
+                            (fwrite(padding, 1, (8 - bytes % 8) % 8, f) != (8 - bytes % 8) % 8)) {
+                            fprintf(stderr, "Unable to write '%s': %s\n",
+                                    path.c_str(), strerror(errno));
+                            abort();
+                        }
+                    };
+
+                auto frozen = freeze();
+                auto last = frozen->size();
+
+                std::vector<uint64_t> name_offsets(1, 0);
+                std::string names;
+                for (const auto& n: _node_list) {
+                    names += n->name();
+                    name_offsets.push_back(names.size());
+                }
+
+                std::vector<snapshot_link> links(frozen->out_begin(last));
+                std::unordered_map<const path_t *, size_t> link_index;
+                for (size_t l = 0; l < links.size(); ++l) {
+                    auto s = frozen->link_source(l);
+                    auto d = frozen->link_dest(l);
+                    links[l].source = s;
+                    links[l].dest = d;
+                    links[l].source_port = frozen->link_port(l);
+                    links[l].dest_port = frozen->port_number_in(d, s);
+                    links[l].cost = frozen->link_cost(l);
+                    link_index[frozen->link_path(l).get()] = l;
+                }
+
+                snapshot_header header;
+                memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+                header.version = snapshot_version;
+                header.byte_order = snapshot_byte_order;
+                header.flags = routes ? snapshot_routes : 0;
+                header.node_count = _node_list.size();
+                header.link_count = links.size();
+                header.name_bytes = names.size();
+
+                write(&header, sizeof(header));
+                write(name_offsets.data(), name_offsets.size() * sizeof(uint64_t));
+                write(names.data(), names.size());
+                write(links.data(), links.size() * sizeof(snapshot_link));
+
+                if (routes == true) {
+                    std::vector<uint64_t> route_offsets(1, 0);
+                    std::vector<snapshot_route> route_table;
+                    for (const auto& n: _node_list) {
+                        n->update_paths();
+                        append_routes(n, frozen, link_index, route_table);
+                        route_offsets.push_back(route_table.size());
+                    }
+
+                    write(route_offsets.data(), route_offsets.size() * sizeof(uint64_t));
+                    write(route_table.data(), route_table.size() * sizeof(snapshot_route));
+                }
+
+                if (fclose(f) != 0) {
+                    fprintf(stderr, "Unable to write '%s': %s\n",
+                            path.c_str(), strerror(errno));
+                    abort();
+                }
+            }
+
+        /* Returns the routing oracle for this network, or NULL if
+         * there isn't one. */
+        std::shared_ptr<oracle_t> oracle(void) const { return _oracle; }
+
         /* Returns the nodes formatted as a grid. */
         std::map< std::pair<size_t, size_t> , node_ptr > grid(void) const
-            { return _grid; }
+            {
+                std::map< std::pair<size_t, size_t>, node_ptr> out;
+                for (size_t i = 0; i < _node_list.size(); ++i) {
+                    auto p = std::make_pair(i % _grid_width, i / _grid_width);
+                    out[p] = _node_list[i];
+                }
+                return out;
+            }
 
         /* Searches for a single node in the grid. */
         node_ptr lookup(size_t x, size_t y) const
             {
-                auto p = std::make_pair(x, y);
-                auto l = _grid.find(p);
-                if (l == _grid.end())
+                if (x >= _grid_width)
                     return NULL;
-                return l->second;
+
+                auto i = y * _grid_width + x;
+                if (i >= _node_list.size())
+                    return NULL;
+                return _node_list[i];
             }
 
         node_ptr lookup(const std::string& name) const
             {
-                auto l = _nodes.find(name);
-                if (l == _nodes.end())
+                auto i = _names.find(_node_list, name);
+                if (i == _names.npos)
                     return NULL;
-                return l->second;
+                return _node_list[i];
+            }
+
+    protected:
+        /* Used by the regular topologies, which build their nodes
+         * once the network's arena exists. */
+        network(builder_t build)
+            : _arena(std::make_shared<arena>()),
+              _node_list(build(*_arena)),
+              _names(),
+              _grid_width(grid_width(_node_list.size())),
+              _oracle(),
+              _routes_recomputed(0),
+              _recomputed()
+            {
+                adopt(_node_list);
+                index_names();
+            }
+
+        /* Creates a direct link between two nodes out of an
+         * arena. */
+        static std::shared_ptr<path_t> new_link(arena& a,
+                                                const node_ptr& s,
+                                                const node_ptr& d,
+                                                size_t cost = 1)
+            {
+                return std::allocate_shared<path_t>(arena_allocator<path_t>(a),
+                                                    s, d, cost);
+            }
+
+        /* Used by the regular topologies to hand over an oracle once
+         * they've been built. */
+        void set_oracle(const std::shared_ptr<oracle_t>& oracle)
+            {
+                _oracle = oracle;
+                _oracle->attach();
             }
 
     private:
-        /* This is used by the constructor to convert a node list to a
-         * map of nodes. */
-        static std::unordered_map<std::string, node_ptr>
-        build_name_map(const std::vector<node_ptr>& nodes)
+        /* Tells every node about a link change.  The oracle describes
+         * the topology as it was built, so it can't be trusted after
+         * any change. */
+        void update_routes(const node_ptr& s, const node_ptr& d,
+                           const std::shared_ptr<path_t>& old_link,
+                           const std::shared_ptr<path_t>& new_link)
             {
-                std::unordered_map<std::string, node_ptr> out;
+                if (_oracle != NULL) {
+                    _oracle->detach();
+                    _oracle = NULL;
+                }
 
-                for (const auto& node : nodes)
-                    out[node->name()] = node;
+                _recomputed.resize(_node_list.size(), false);
+                for (size_t i = 0; i < _node_list.size(); ++i) {
+                    if (_node_list[i]->link_changed(s, d, old_link, new_link) == false)
+                        continue;
 
-                return out;
+                    if (_recomputed[i] == false) {
+                        _recomputed[i] = true;
+                        _routes_recomputed++;
+                    }
+                }
+            }
+
+        static void missing_link(const node_ptr& s, const node_ptr& d)
+            {
+                fprintf(stderr, "No link from '%s' to '%s'\n",
+                        s->name().c_str(), d->name().c_str());
+                abort();
+            }
+
+        /* This is used by the constructors to fill out the name
+         * table. */
+        void index_names(void)
+            {
+                for (size_t i = 0; i < _node_list.size(); ++i) {
+                    if (_names.insert(_node_list, i) == false) {
+                        fprintf(stderr, "Duplicate node name '%s'\n",
+                                _node_list[i]->name().c_str());
+                        abort();
+                    }
+                }
             }
 
-        /* Reads a file (by path) to produce a list of nodes. */
+        /* A node's UID is just its index in the node list.  Nodes
+         * can only be part of a single network at a time (as the
+         * network takes their links away when it goes), so this
+         * refuses to take a node that's already in one. */
+        static void adopt(const std::vector<node_ptr>& nodes)
+            {
+                for (size_t i = 0; i < nodes.size(); ++i) {
+                    auto& n = *nodes[i];
+                    if (n._uid != node_t::no_uid) {
+                        fprintf(stderr, "Node '%s' is already part of a network\n",
+                                n.name().c_str());
+                        abort();
+                    }
+
+                    n._uid = i;
+                }
+            }
+
+        /* Saves a single node's shortest-path tree for a snapshot.
+         * Routes are written out parents-first, which lets the loader
+         * make sure there are no loops. */
+        static void append_routes(
+            const node_ptr& n,
+            const std::shared_ptr<compiled_t>& frozen,
+            const std::unordered_map<const path_t *, size_t>& link_index,
+            std::vector<snapshot_route>& out)
+            {
+                const auto& routes = n->_routes;
+                std::vector<size_t> first_child(routes.size(), node_t::no_parent);
+                std::vector<size_t> next_sibling(routes.size(), node_t::no_parent);
+                std::vector<size_t> stack;
+                for (size_t i = routes.size(); i-- > 0;) {
+                    auto p = routes[i].parent;
+                    if (p == node_t::no_parent) {
+                        stack.push_back(i);
+                        continue;
+                    }
+                    next_sibling[i] = first_child[p];
+                    first_child[p] = i;
+                }
+
+                std::vector<uint64_t> remap(routes.size(), snapshot_no_parent);
+                auto base = out.size();
+                while (stack.size() != 0) {
+                    auto i = stack.back(); stack.pop_back();
+                    const auto& r = routes[i];
+
+                    auto l = link_index.find(r.hop.get());
+                    if (l == link_index.end()) {
+                        fprintf(stderr, "Route from '%s' uses a missing link\n",
+                                n->name().c_str());
+                        abort();
+                    }
+
+                    snapshot_route entry;
+                    entry.dest = frozen->index(r.hop->d());
+                    entry.parent = (r.parent == node_t::no_parent)
+                        ? snapshot_no_parent
+                        : remap[r.parent];
+                    entry.cost = r.cost;
+                    entry.link = l->second;
+
+                    remap[i] = out.size() - base;
+                    out.push_back(entry);
+
+                    for (auto c = first_child[i]; c != node_t::no_parent; c = next_sibling[c])
+                        stack.push_back(c);
+                }
+            }
+
+        /* Reads a file (by path) to produce a list of nodes, which
+         * can be in either the text or snapshot format.  The nodes
+         * have already been given their UIDs. */
         static std::vector<node_ptr> read_file(
             const std::string& path,
-            std::function<node_ptr(std::string)> fn)
+            std::function<node_ptr(std::string)> fn,
+            arena& a)
+            {
+                mapped_file file(path);
+                LIBOCN_COUNT(bytes_read, file.size());
+
+                if ((file.size() >= sizeof(snapshot_header)) &&
+                    (memcmp(file.data(), snapshot_magic, sizeof(snapshot_magic)) == 0))
+                    return read_snapshot(path, file, fn, a);
+
+                auto out = read_text(path, file, fn, a);
+                adopt(out);
+                return out;
+            }
+
+        /* Walks through a single line of a text network file. */
+        struct text_cursor {
+            const char *begin;
+            const char *p;
+            const char *end;
+            const char *expected;
+
+            text_cursor(const char *_begin, const char *_end)
+                : begin(_begin), p(_begin), end(_end), expected(NULL)
+                {
+                }
+
+            void skip_space(void)
+                {
+                    while ((p < end) && ((*p == ' ') || (*p == '\t')))
+                        p++;
+                }
+
+            /* A node name, which is anything between quotes. */
+            bool name(const char *& out, size_t& length)
+                {
+                    skip_space();
+                    expected = "a quoted node name";
+                    if ((p == end) || (*p != '"'))
+                        return false;
+
+                    auto close = (const char *)memchr(p + 1, '"', end - p - 1);
+                    if ((close == NULL) || (close == p + 1))
+                        return false;
+
+                    out = p + 1;
+                    length = close - out;
+                    p = close + 1;
+                    return true;
+                }
+
+            bool number(size_t& out)
+                {
+                    skip_space();
+                    expected = "a number";
+                    if ((p == end) || (*p < '0') || (*p > '9'))
+                        return false;
+
+                    out = 0;
+                    while ((p < end) && (*p >= '0') && (*p <= '9'))
+                        out = out * 10 + (*p++ - '0');
+                    return true;
+                }
+
+            bool literal(const char *s)
+                {
+                    skip_space();
+                    expected = s;
+                    auto length = strlen(s);
+                    if (((size_t)(end - p) < length) || (memcmp(p, s, length) != 0))
+                        return false;
+
+                    p += length;
+                    return true;
+                }
+
+            /* Only whitespace is allowed after the last field. */
+            bool end_of_line(void)
+                {
+                    skip_space();
+                    expected = "the end of the line";
+                    while ((p < end) && (*p == '\r'))
+                        p++;
+                    return p == end;
+                }
+        };
+
+        /* Parses the text format, where every line looks like
+
+               "source" <port> -> "dest" <port>: <cost>
+
+         * or is a comment that starts with '#'. */
+        static std::vector<node_ptr> read_text(
+            const std::string& path,
+            const mapped_file& file,
+            std::function<node_ptr(std::string)> fn,
+            arena& a)
             {
                 std::vector<node_ptr> out;
-                std::unordered_map<std::string, node_ptr> name_map;
-                size_t line_num = 0;
-                FILE *f = fopen(path.c_str(), "r");
-                char line[BUFFER_SIZE];
+                name_table<node_t> names;
 
-                while (fgets(line, BUFFER_SIZE, f) != NULL) {
+                /* Looking up names happens on every line, so they're
+                 * looked up straight out of the file and only get
+                 * copied when a new node is created. */
+                auto add_node = [&](const char *name, size_t length)
+                    -> node_ptr
+                    {
+                        auto i = names.find(out, name, length);
+                        if (i != names.npos)
+                            return out[i];
+
+                        out.push_back(fn(std::string(name, length)));
+                        if (names.insert(out, out.size() - 1) == false) {
+                            fprintf(stderr, "Duplicate node name '%s'\n",
+                                    out.back()->name().c_str());
+                            abort();
+                        }
+                        return out.back();
+                    };
+
+                const char *p = file.data();
+                const char *end = p + file.size();
+                size_t line_num = 0;
+                while (p < end) {
                     line_num++;
 
+                    auto line = p;
+                    auto eol = (const char *)memchr(p, '\n', end - p);
+                    if (eol == NULL)
+                        eol = end;
+                    p = (eol == end) ? end : eol + 1;
+
                     /* This signifies a comment character. */
-                    if (line[0] == '#')
+                    if ((line == eol) || (line[0] == '#'))
                         continue;
 
-                    /* Now we parse the string...  Here '%[^\"]' means
-                     * a string that ends with '"'. */
-                    char source[BUFFER_SIZE], dest[BUFFER_SIZE];
-                    int source_port, dest_port, cost;
-                    int scanned = sscanf(line,
-                                         "\"%[^\"]\" %d -> \"%[^\"]\" %d: %d",
-                                         source, &source_port,
-                                         dest, &dest_port,
-                                         &cost);
-                    if (scanned != 5) {
-                        fprintf(stderr, "Unable to parse line: '%s'\n", line);
-                        fprintf(stderr, "  Read %d tokens\n", scanned);
-
-                        switch (scanned) {
-                        case 5:
-                            fprintf(stderr, "  5: %d\n", cost);
-                        case 4:
-                            fprintf(stderr, "  4: %d\n", dest_port);
-                        case 3:
-                            fprintf(stderr, "  3: '%s'\n", dest);
-                        case 2:
-                            fprintf(stderr, "  2: %d\n", source_port);
-                        case 1:
-                            fprintf(stderr, "  1: '%s'\n", source);
-                        }
-
+                    text_cursor c(line, eol);
+                    const char *source, *dest;
+                    size_t source_length, dest_length;
+                    size_t source_port, dest_port, cost;
+                    bool parsed = c.name(source, source_length)
+                        && c.number(source_port)
+                        && c.literal("->")
+                        && c.name(dest, dest_length)
+                        && c.number(dest_port)
+                        && c.literal(":")
+                        && c.number(cost)
+                        && c.end_of_line();
+                    if (parsed == false) {
+                        fprintf(stderr, "Unable to parse line " SIZET_FORMAT " of '%s': '%.*s'\n",
+                                line_num, path.c_str(), (int)(eol - line), line);
+                        fprintf(stderr, "  Expected %s at column " SIZET_FORMAT "\n",
+                                c.expected, (size_t)(c.p - c.begin + 1));
                         abort();
                     }
 
-                    /* At this point we have the parsed file, so we
-                     * just need to add this to the big list.  First
-                     * we make sure that these nodes have already
-                     * added to the list of nodes we know about. */
-                    auto add_node = [&out, &name_map, &fn]
-                        (const std::string& s) -> node_ptr
-                        {
-                            auto l = name_map.find(s);
-                            if (l == name_map.end()) {
-                                auto n = fn(s);
-                                name_map[s] = n;
-                                out.push_back(n);
-                                return n;
-                            }
-
-                            return l->second;
-                        };
-                    auto s = add_node(source);
-                    auto d = add_node(dest);
+                    /* At this point we have the parsed line, so we
+                     * just need to add this to the big list. */
+                    auto s = add_node(source, source_length);
+                    auto d = add_node(dest, dest_length);
 
                     /* Create a direct path between these two
                      * nodes. */
-                    auto p = std::make_shared<path_t>(s, d, cost);
-                    s->add_path(p, source_port, dest_port);
+                    auto link = new_link(a, s, d, cost);
+                    s->add_path(link, source_port, dest_port);
                 }
 
-                fclose(f);
                 return out;
             }
 
-        /* Produces a grid from a list of nodes.  Note that this is a
-         * bit screwy: it relies on the implicit ordering of */
-        static
-        std::map< std::pair<size_t, size_t>, node_ptr>
-        build_grid(const std::vector<node_ptr>& nodes)
+        /* Loads a binary snapshot.  Everything is checked before
+         * it's used, as snapshots are read straight out of the file
+         * without any parsing. */
+        static std::vector<node_ptr> read_snapshot(
+            const std::string& path,
+            const mapped_file& file,
+            std::function<node_ptr(std::string)> fn,
+            arena& a)
             {
-                std::map< std::pair<size_t, size_t>, node_ptr> out;
+                auto fail = [&](const char *why)
+                    {
+                        fprintf(stderr, "Bad snapshot '%s': %s\n",
+                                path.c_str(), why);
+                        abort();
+                    };
 
-                size_t width = (size_t)(floor(sqrt(nodes.size())));
-                for (size_t i = 0; i < nodes.size(); ++i) {
-                    auto x = i % width;
-                    auto y = i / width;
-                    auto p = std::make_pair(x, y);
-                    out[p] = nodes[i];
+                /* Returns the next section of the file, which holds
+                 * "count" objects of the given size. */
+                size_t offset = 0;
+                auto section = [&](uint64_t count, size_t size) -> const char *
+                    {
+                        auto left = file.size() - offset;
+                        if (count > left / size)
+                            fail("file is truncated");
+
+                        auto out = file.data() + offset;
+                        offset += (count * size + 7) / 8 * 8;
+                        if (offset > file.size())
+                            offset = file.size();
+                        return out;
+                    };
+
+                auto header = (const snapshot_header *)
+                    section(1, sizeof(snapshot_header));
+                if (header->byte_order != snapshot_byte_order)
+                    fail("written with a different byte order");
+                if (header->version != snapshot_version)
+                    fail("unsupported version");
+
+                auto node_count = header->node_count;
+                auto link_count = header->link_count;
+                if (node_count >= file.size())
+                    fail("file is truncated");
+
+                auto name_offsets = (const uint64_t *)
+                    section(node_count + 1, sizeof(uint64_t));
+                auto names = section(header->name_bytes, 1);
+                auto links = (const snapshot_link *)
+                    section(link_count, sizeof(snapshot_link));
+
+                std::vector<node_ptr> out;
+                out.reserve(node_count);
+                for (size_t i = 0; i < node_count; ++i) {
+                    auto b = name_offsets[i];
+                    auto e = name_offsets[i+1];
+                    if ((b > e) || (e > header->name_bytes))
+                        fail("bad node name");
+                    out.push_back(fn(std::string(names + b, e - b)));
+                }
+
+                /* Routes are indexed by UID, so the nodes need them
+                 * before any routes can be installed. */
+                adopt(out);
+
+                std::vector<std::shared_ptr<path_t>> paths;
+                paths.reserve(link_count);
+                for (size_t l = 0; l < link_count; ++l) {
+                    const auto& link = links[l];
+                    if ((link.source >= node_count) || (link.dest >= node_count))
+                        fail("link to a missing node");
+
+                    auto s = out[link.source];
+                    auto p = new_link(a, s, out[link.dest], link.cost);
+                    s->add_path(p, link.source_port, link.dest_port);
+                    paths.push_back(p);
+                }
+
+                if ((header->flags & snapshot_routes) == 0)
+                    return out;
+
+                auto route_offsets = (const uint64_t *)
+                    section(node_count + 1, sizeof(uint64_t));
+                auto routes = (const snapshot_route *)
+                    section(route_offsets[node_count], sizeof(snapshot_route));
+
+                for (size_t i = 0; i < node_count; ++i) {
+                    auto b = route_offsets[i];
+                    auto e = route_offsets[i+1];
+                    if ((b > e) || (e > route_offsets[node_count]))
+                        fail("bad route table");
+
+                    auto n = out[i];
+                    n->clear_routes();
+                    n->_routes.reserve(e - b);
+                    n->_route_index.reserve(node_count);
+                    for (auto r = routes + b; r < routes + e; ++r) {
+                        if ((r->dest >= node_count) || (r->link >= link_count))
+                            fail("route to a missing node");
+
+                        /* Parents always come first, so this can't
+                         * loop. */
+                        auto parent = node_t::no_parent;
+                        auto from = n;
+                        uint64_t parent_cost = 0;
+                        if (r->parent != snapshot_no_parent) {
+                            if (r->parent >= (uint64_t)(r - (routes + b)))
+                                fail("route comes before its parent");
+                            parent = r->parent;
+                            from = out[routes[b + parent].dest];
+                            parent_cost = routes[b + parent].cost;
+                        }
+
+                        if (n->find_route(r->dest) != node_t::no_parent)
+                            fail("duplicate route destination");
+
+                        auto link = paths[r->link];
+                        if ((link->s() != from) || (link->d() != out[r->dest]))
+                            fail("route takes the wrong link");
+                        if (r->cost != parent_cost + link->cost())
+                            fail("route cost doesn't match its links");
+
+                        n->add_route(out[r->dest], paths[r->link], parent, r->cost);
+                    }
+                    n->_paths_valid = true;
                 }
 
                 return out;
             }
+
+        /* Produces a grid from a list of nodes.  Note that this is a
+         * bit screwy: it relies on the implicit ordering of the node
+         * list, which is laid out row by row on the largest square
+         * that fits. */
+        static size_t grid_width(size_t count)
+            {
+                size_t width = (size_t)(floor(sqrt(count)));
+                return (width == 0) ? 1 : width;
+            }
     };
 }
 
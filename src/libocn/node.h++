@@ -24,16 +24,25 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include <unordered_map>
 #include <memory>
-#include <stack>
+#include <functional>
+#include <queue>
 #include <string>
 #include <vector>
 
+#include "arena.h++"
 #include "path.h++"
+#include "counters.h++"
+#include "routing_oracle.h++"
 #include "sizet_printf.h++"
 
 namespace libocn {
+    template<class node_t> class compiled_network;
+    template<class node_t> class routing_oracle;
+    template<class node_t> class network;
+
     /* This stores a single node in the network along with every
      * path. */
     template<class node_t>
@@ -42,21 +51,58 @@ namespace libocn {
         typedef std::shared_ptr<path<node_t>> path_ptr;
         typedef path<node_t> path_t;
 
-    private:
-        static std::unordered_map<std::string, size_t> name2uid;
+        /* Freezing a network needs to walk the neighbor lists
+         * directly, and both searches on the frozen network and
+         * routing oracles hand their results straight back to the
+         * nodes. */
+        friend class compiled_network<node_t>;
+        friend class routing_oracle<node_t>;
+
+        /* The network keeps every node's routes up to date when its
+         * links change. */
+        friend class network<node_t>;
 
     private:
         /* This stores the name of the node.  If this isn't unique
          * then things are going to go poorly! */
         const std::string _name;
 
-        /* This stores a map that maps a destination node to the path
-         * that can be taken in order to reach that destination from
-         * this node.  Note that there's a valid bit here to avoid
-         * having to search too often: the rule is that the graph is
-         * searched whenever */
+        /* A single entry in the shortest-path tree that's rooted at
+         * this node.  Rather than storing a whole path for every
+         * destination we just store the last hop that's taken to get
+         * there along with the route that gets to the start of that
+         * hop, which is enough to rebuild the full path later. */
+        struct route {
+            path_ptr hop;
+            size_t parent;
+            size_t cost;
+
+            route(const path_ptr& _hop, size_t _parent, size_t _cost)
+                : hop(_hop),
+                  parent(_parent),
+                  cost(_cost)
+                {
+                }
+        };
+
+        /* This is the parent index used by routes whose hop leaves
+         * directly from this node. */
+        static const size_t no_parent = (size_t)(-1);
+
+        /* This stores the shortest-path tree that's rooted at this
+         * node, along with the index of the route to every
+         * destination (by UID, or "no_parent" if there isn't one).
+         * Note that there's a valid bit here to avoid having to
+         * search too often: the rule is that the graph is searched
+         * whenever someone asks for a path and this isn't set. */
         bool _paths_valid;
-        std::unordered_map<std::string, path_ptr> _paths;
+        std::vector<route> _routes;
+        std::vector<size_t> _route_index;
+
+        /* Full paths are only built when someone actually asks for
+         * them, at which point they're cached here (indexed the same
+         * way as "_routes") so they're only built once. */
+        std::vector<path_ptr> _paths;
 
         /* This stores the list of neighbors of this node, which is
          * used for the shortest-path algorithm later.  Note that this
@@ -66,73 +112,85 @@ namespace libocn {
         std::unordered_map<size_t, path_ptr> _incoming_neighbors;
         std::unordered_map<size_t, path_ptr> _outgoing_neighbors;
 
-        /* Stores a unique ID for this node. */
+        /* Stores a unique ID for this node, which is its index in
+         * the network that it's a part of.  It's "no_uid" until the
+         * node has been added to a network. */
         size_t _uid;
 
+        /* Nodes that are part of a regular topology can have their
+         * routes computed directly by that topology, rather than by
+         * searching the graph.  This is only a weak reference: the
+         * network owns the oracle. */
+        std::weak_ptr<routing_oracle<node_t>> _oracle;
+
     public:
+        /* Used for nodes that aren't part of a network yet. */
+        static const size_t no_uid = (size_t)(-1);
+
         /* Creates a node without any paths, given a name that
-         * uniquely identifies that node.  This name will be checked
-         * for uniquness at create time. */
+         * uniquely identifies that node within its network.  Nodes
+         * don't get a UID until they're added to a network, which
+         * is also where names are checked for uniqueness. */
         node(const std::string& name)
             : _name(name),
               _paths_valid(true),
+              _routes(),
+              _route_index(),
               _paths(),
-              _uid(get_uid(name))
-            {
-            }
-
-        /* A node destructor. */
-        ~node(void)
+              _uid(no_uid),
+              _oracle()
             {
-                put_uid(name());
             }
 
         /* Returns the name of a node. */
         const std::string& name(void) const { return _name; }
 
-        /* Returns a unique ID for this node. */
+        /* Returns a unique ID for this node, which is a dense index
+         * that's local to its network. */
         size_t uid(void) const { return _uid; }
 
         /* Returns the path that must be taken in order to get from
          * this node to the provided node. */
         const path_ptr search(const node_ptr& that)
             {
+                /* If there's an oracle around then a single route can
+                 * be built directly, without filling out every
+                 * route from this node. */
+                auto oracle = _oracle.lock();
+                if ((_paths_valid == false) && (oracle != NULL)) {
+                    auto s = oracle->uid_index(uid());
+                    auto d = oracle->index(that);
+                    if ((s != oracle->npos) && (d != oracle->npos))
+                        return oracle->route(s, d);
+                }
+
                 update_paths();
 
-                auto l = this->_paths.find(that->name());
-                if (l == this->_paths.end())
+                /* UIDs are only unique within a network, so this
+                 * makes sure the route actually goes to that node. */
+                auto i = find_route(that->uid());
+                if ((i == no_parent) || (_routes[i].hop->d() != that))
                     return NULL;
 
-                return l->second;
+                return build_path(i);
             }
 
         /* Returns TRUE if the target node is a neighbor of this
          * node. */
         bool is_neighbor(const node_ptr& that) const
             {
-                auto l = this->_paths.find(that->name());
-                if (l == this->_paths.end())
-                    return false;
-                return (l->second->is_direct() == true);
+                return find_link(that) != NULL;
             }
 
         /* Informs this node of a path that it can take in order to
-         * reach another node. */
+         * reach another node.  This is meant for building networks:
+         * it doesn't tell any other node about the new path, see
+         * "network::add_link()" for that. */
         void add_path(path_ptr new_path)
             {
-                auto find_port = []
-                    (std::unordered_map<size_t, path_ptr>& map) -> size_t
-                    {
-                        for (size_t i = 0; i <= map.size(); ++i)
-                            if (map.find(i) == map.end())
-                                return i;
-
-                        return map.size();
-                    };
-
                 return add_path(new_path,
-                                find_port(new_path->s()->_outgoing_neighbors),
-                                find_port(new_path->d()->_incoming_neighbors)
+                                free_port(new_path->s()->_outgoing_neighbors),
+                                free_port(new_path->d()->_incoming_neighbors)
                     );
             }
 
@@ -141,17 +199,14 @@ namespace libocn {
                 /* Check if there was an old path to this target.  If
                  * so we're going to need to replace the path, but
                  * only if it's worse than the new path. */
-                auto old_path_l = _paths.find(new_path->d()->name());
-                path_ptr old_path = NULL;
-                if (old_path_l != _paths.end())
-                    old_path = old_path_l->second;
+                auto old_path = new_path->s()->find_link(new_path->d());
 
                 /* If there was an old path and it's better then do
                  * nothing. */
                 if ((old_path != NULL) && (old_path->cost() <= new_path->cost()))
                     return;
 
-                _paths[new_path->d()->name()] = new_path;
+                new_path->s()->_paths_valid = false;
                 _paths_valid = false;
 
                 /* A direct path is one that's only a single hop --
@@ -188,6 +243,77 @@ namespace libocn {
                 }
             }
 
+        /* A faster version of "add_path()" for building regular
+         * networks, where links are only ever appended to nodes
+         * whose ports are already numbered densely from 0.  Each new
+         * link just goes on the next port on both sides, without
+         * checking for an existing link or searching for a free
+         * port, which is the same port "add_path()" would have
+         * picked.  "reserve_links()" avoids re-hashing the port maps
+         * when the final number of links is known up front. */
+        void reserve_links(size_t outgoing, size_t incoming)
+            {
+                _outgoing_neighbors.reserve(outgoing);
+                _incoming_neighbors.reserve(incoming);
+            }
+
+        void append_link(const path_ptr& link)
+            {
+                LIBOCN_COUNT(build_steps, 1);
+                auto d = link->d();
+                _outgoing_neighbors[_outgoing_neighbors.size()] = link;
+                d->_incoming_neighbors[d->_incoming_neighbors.size()] = link;
+                _paths_valid = false;
+            }
+
+        /* Returns the direct path from this node to another one, or
+         * NULL if they're not neighbors. */
+        path_ptr find_link(const node_ptr& that) const
+            {
+                for (const auto& p: _outgoing_neighbors)
+                    if (p.second->d() == that)
+                        return p.second;
+
+                return NULL;
+            }
+
+        /* These modify the direct links that leave this node.  They
+         * only change the links themselves: any routes that were
+         * already computed aren't touched, so you probably want to
+         * use the versions in "network" instead, which keep them up
+         * to date.  New links (which must leave from this node) take
+         * the first free port on each side, re-weighted links keep
+         * their ports. */
+        void add_link(const path_ptr& link)
+            {
+                auto d = link->d();
+                _outgoing_neighbors[free_port(_outgoing_neighbors)] = link;
+                d->_incoming_neighbors[free_port(d->_incoming_neighbors)] = link;
+            }
+
+        path_ptr remove_link(const node_ptr& that)
+            {
+                auto link = find_link(that);
+                if (link == NULL)
+                    return NULL;
+
+                erase_link(_outgoing_neighbors, link);
+                erase_link(that->_incoming_neighbors, link);
+                return link;
+            }
+
+        path_ptr set_link_cost(const node_ptr& that, size_t cost)
+            {
+                auto old_link = find_link(that);
+                if (old_link == NULL)
+                    return NULL;
+
+                auto link = std::make_shared<path_t>(old_link->s(), that, cost);
+                replace_link(_outgoing_neighbors, old_link, link);
+                replace_link(that->_incoming_neighbors, old_link, link);
+                return link;
+            }
+
         /* Returns a list of every path that this node knows how to
          * connect to. */
         std::vector<path_ptr> paths(void)
@@ -195,8 +321,9 @@ namespace libocn {
                 update_paths();
 
                 std::vector<path_ptr> out;
-                for (const auto& pair : _paths)
-                    out.push_back(pair.second);
+                out.reserve(_routes.size());
+                for (size_t i = 0; i < _routes.size(); ++i)
+                    out.push_back(build_path(i));
                 return out;
             }
 
@@ -235,8 +362,8 @@ namespace libocn {
             }
 
     private:
-        /* Checks "_paths" for validity, updating it if it hasn't been
-         * updated already. */
+        /* Checks "_routes" for validity, updating it if it hasn't
+         * been updated already. */
         void update_paths(void)
             {
                 /* If we haven't already cached the answer then
@@ -246,54 +373,513 @@ namespace libocn {
                 if (this->_paths_valid == true)
                     return;
 
-                /* Here we create a stack that contains all the new
-                 * paths that have been discovered as the result of
-                 * this addition. */
-                std::stack<path_ptr> paths;
-                for (const auto& pair : _paths)
-                    paths.push(pair.second);
+                /* UIDs are handed out by the network, so a node that
+                 * was never put in one can't index its routes. */
+                if (_uid == no_uid) {
+                    fprintf(stderr, "Node '%s' isn't part of a network\n",
+                            name().c_str()
+                        );
+                    abort();
+                }
+
+                /* Regular topologies can tell us the routes without
+                 * any searching at all. */
+                auto oracle = _oracle.lock();
+                if (oracle != NULL) {
+                    auto i = oracle->uid_index(uid());
+                    if (i != oracle->npos)
+                        return oracle->install(i);
+                }
+
+                /* Every built-in topology has unit-cost links, in
+                 * which case a plain breadth-first search finds the
+                 * shortest paths.  That gives up as soon as it sees a
+                 * link with any other cost, in which case we fall
+                 * back to Dijkstra's algorithm. */
+                if (breadth_first_search() == false)
+                    dijkstra_search();
+
+                /* Now we can set that flag so this never gots called again. */
+                this->_paths_valid = true;
+            }
+
+        /* Clears out the shortest-path tree in preparation for a new
+         * search. */
+        void clear_routes(void)
+            {
+                _routes.clear();
+                _route_index.clear();
+                _paths.clear();
+            }
+
+        /* Drops every route, along with the links that were
+         * allocated from the given arena, which is used when this
+         * node's network (which created those links) goes away.  Any
+         * other links stay put, so the node is left as if they were
+         * the only ones that had ever been added to it. */
+        void release(const arena& links)
+            {
+                auto drop = [&](std::unordered_map<size_t, path_ptr>& map)
+                    {
+                        for (auto it = map.begin(); it != map.end();) {
+                            if (links.contains(it->second.get()))
+                                it = map.erase(it);
+                            else
+                                ++it;
+                        }
+                    };
+
+                clear_routes();
+                drop(_incoming_neighbors);
+                drop(_outgoing_neighbors);
+                _paths_valid = (_outgoing_neighbors.size() == 0);
+                _uid = no_uid;
+                _oracle.reset();
+            }
+
+        /* Adds a new route to the shortest-path tree. */
+        void add_route(const node_ptr& d, const path_ptr& hop,
+                       size_t parent, size_t cost)
+            {
+                if (d->uid() >= _route_index.size())
+                    _route_index.resize(d->uid() + 1, no_parent);
+                _route_index[d->uid()] = _routes.size();
+                _routes.push_back(route(hop, parent, cost));
+            }
+
+        /* Returns the index of the route to the node with the given
+         * UID, or "no_parent" if there isn't one. */
+        size_t find_route(size_t uid) const
+            {
+                if (uid >= _route_index.size())
+                    return no_parent;
+                return _route_index[uid];
+            }
+
+        /* Fills out the shortest-path tree from a search that was
+         * run against a frozen copy of the network. */
+        template<class state_t>
+        void set_routes(const compiled_network<node_t>& frozen,
+                        const state_t& state)
+            {
+                clear_routes();
+                _routes.reserve(state.order.size());
+
+                for (const auto& d: state.order) {
+                    auto l = state.link[d];
+                    auto s = frozen.link_source(l);
+                    auto parent = (s == state.source) ? no_parent : state.rank[s];
+                    add_route(frozen.at(d), frozen.link_path(l), parent, state.cost[d]);
+                }
+
+                _paths_valid = true;
+            }
+
+        /* Fills out the shortest-path tree, assuming that every link
+         * costs 1.  Returns FALSE if a link with some other cost is
+         * found, in which case the tree isn't valid. */
+        bool breadth_first_search(void)
+            {
+                clear_routes();
+
+                /* The route list doubles as the search queue here:
+                 * because every link costs the same, routes are
+                 * discovered in order of increasing cost. */
+                auto visit = [this](const path_ptr& hop,
+                                    size_t parent,
+                                    size_t cost) -> bool
+                    {
+                        if (hop->cost() != 1)
+                            return false;
+
+                        auto d = hop->d();
+                        if (d->uid() == this->uid())
+                            return true;
+                        if (find_route(d->uid()) != no_parent)
+                            return true;
+
+                        add_route(d, hop, parent, cost + 1);
+                        return true;
+                    };
+
+                /* Every route that gets added is a relaxation. */
+                auto done = [this](bool out) -> bool
+                    {
+                        LIBOCN_COUNT(relaxations, _routes.size());
+                        return out;
+                    };
+
+                for (const auto& p: _outgoing_neighbors)
+                    if (visit(p.second, no_parent, 0) == false)
+                        return done(false);
+
+                for (size_t i = 0; i < _routes.size(); ++i) {
+                    auto n = _routes[i].hop->d();
+                    for (const auto& p: n->_outgoing_neighbors)
+                        if (visit(p.second, i, _routes[i].cost) == false)
+                            return done(false);
+                }
+
+                return done(true);
+            }
+
+        /* Fills out the shortest-path tree using Dijkstra's
+         * algorithm, which works for any link costs. */
+        void dijkstra_search(void)
+            {
+                clear_routes();
+
+                /* Candidate routes live in their own list, the heap
+                 * just orders indices into that list by cost.  Stale
+                 * candidates are skipped when they're popped rather
+                 * than being removed from the heap. */
+                typedef std::pair<size_t, size_t> heap_entry;
+                std::priority_queue<heap_entry,
+                                    std::vector<heap_entry>,
+                                    std::greater<heap_entry>> heap;
+                std::vector<route> candidates;
+                std::vector<size_t> best;
+
+                auto relax = [&](const path_ptr& hop,
+                                 size_t parent,
+                                 size_t cost)
+                    {
+                        auto d = hop->d();
+                        if (d->uid() == this->uid())
+                            return;
+
+                        auto c = cost + hop->cost();
+                        if (d->uid() >= best.size())
+                            best.resize(d->uid() + 1, no_parent);
+                        if (best[d->uid()] <= c)
+                            return;
+
+                        best[d->uid()] = c;
+                        candidates.push_back(route(hop, parent, c));
+                        heap.push(std::make_pair(c, candidates.size() - 1));
+                    };
+
+                for (const auto& p: _outgoing_neighbors)
+                    relax(p.second, no_parent, 0);
+
+                while (heap.size() != 0) {
+                    auto top = heap.top(); heap.pop();
+                    auto c = candidates[top.second];
+
+                    auto d = c.hop->d();
+                    if (find_route(d->uid()) != no_parent)
+                        continue;
+
+                    add_route(d, c.hop, c.parent, c.cost);
+
+                    auto i = _routes.size() - 1;
+                    for (const auto& p: d->_outgoing_neighbors)
+                        relax(p.second, i, c.cost);
+                }
+
+                /* Every candidate was both a relaxation and a push. */
+                LIBOCN_COUNT(relaxations, candidates.size());
+                LIBOCN_COUNT(heap_pushes, candidates.size());
+            }
+
+        /* Produces the full path for a route in the shortest-path
+         * tree by walking the tree back up to this node. */
+        path_ptr build_path(size_t i)
+            {
+                if (_paths.size() != _routes.size())
+                    _paths.resize(_routes.size());
+
+                if (_paths[i] != NULL)
+                    return _paths[i];
+
+                /* Direct paths are already sitting around in the
+                 * neighbor list, so there's no need to make a new
+                 * one. */
+                const auto& r = _routes[i];
+                if (r.parent == no_parent)
+                    return _paths[i] = r.hop;
+
+                std::vector<node_ptr> steps;
+                size_t root = i;
+                for (size_t p = r.parent; p != no_parent; p = _routes[p].parent) {
+                    steps.push_back(_routes[p].hop->d());
+                    root = p;
+                }
+                std::reverse(steps.begin(), steps.end());
+
+                return _paths[i] = std::make_shared<path_t>(
+                    _routes[root].hop->s(),
+                    r.hop->d(),
+                    steps,
+                    r.cost
+                    );
+            }
+
+        /* Called by the network whenever the link from "u" to "v"
+         * changes: "old_link" is NULL when a link is added and
+         * "new_link" is NULL when one is removed.  The links
+         * themselves have already been changed by the time this is
+         * called.  Returns TRUE if any of this node's routes had to
+         * be recomputed. */
+        bool link_changed(const node_ptr& u, const node_ptr& v,
+                          const path_ptr& old_link,
+                          const path_ptr& new_link)
+            {
+                /* Nodes that haven't searched yet will see the new
+                 * links whenever they do. */
+                if (_paths_valid == false)
+                    return false;
+
+                auto v_i = find_route(v->uid());
+                auto u_cost = route_cost(u);
+                auto v_cost = route_cost(v);
+
+                /* If the link is in our tree then anything below it
+                 * could change, otherwise the only thing that matters
+                 * is if the link makes some route cheaper. */
+                bool used = (old_link != NULL)
+                    && (v_i != no_parent)
+                    && (_routes[v_i].hop == old_link);
+
+                if (used == true) {
+                    auto& r = _routes[v_i];
+                    if ((new_link != NULL) && (new_link->cost() == old_link->cost())) {
+                        r.hop = new_link;
+                        _paths.clear();
+                        return false;
+                    }
+
+                    if ((new_link != NULL) && (new_link->cost() < old_link->cost())) {
+                        improve_routes(v, new_link, r.parent, u_cost + new_link->cost());
+                        return true;
+                    }
+
+                    reroute_subtree(v_i);
+                    return true;
+                }
+
+                if ((new_link == NULL) || (u_cost == no_parent))
+                    return false;
+                if (u_cost + new_link->cost() >= v_cost)
+                    return false;
+
+                auto parent = (u->uid() == uid())
+                    ? no_parent
+                    : find_route(u->uid());
+                improve_routes(v, new_link, parent, u_cost + new_link->cost());
+                return true;
+            }
+
+        /* Returns the cost of getting to a node from this one, or
+         * "no_parent" if it can't be reached. */
+        size_t route_cost(const node_ptr& n) const
+            {
+                if (n->uid() == uid())
+                    return 0;
 
-                /* Start out without any paths in this node, none of
-                 * them are actually valid any more. */
+                auto i = find_route(n->uid());
+                if (i == no_parent)
+                    return no_parent;
+                return _routes[i].cost;
+            }
+
+        /* Some link just got cheaper, which makes the route to "n"
+         * cheaper.  That can only make the routes that go on from
+         * there cheaper, so this just runs Dijkstra's algorithm
+         * outwards from "n" for as long as it keeps finding cheaper
+         * routes.  Routes that change are updated in place, so the
+         * indices of every other route stay the same. */
+        void improve_routes(const node_ptr& n, const path_ptr& hop,
+                            size_t parent, size_t cost)
+            {
+                struct candidate {
+                    node_ptr n;
+                    route r;
+
+                    candidate(const node_ptr& _n, const route& _r)
+                        : n(_n), r(_r)
+                        {
+                        }
+                };
+
+                typedef std::pair<size_t, size_t> heap_entry;
+                std::priority_queue<heap_entry,
+                                    std::vector<heap_entry>,
+                                    std::greater<heap_entry>> heap;
+                std::vector<candidate> candidates;
+
+                candidates.push_back(candidate(n, route(hop, parent, cost)));
+                heap.push(std::make_pair(cost, 0));
+
+                while (heap.size() != 0) {
+                    auto c = candidates[heap.top().second]; heap.pop();
+                    if (c.r.cost >= route_cost(c.n))
+                        continue;
+
+                    auto i = find_route(c.n->uid());
+                    if (i == no_parent) {
+                        i = _routes.size();
+                        add_route(c.n, c.r.hop, c.r.parent, c.r.cost);
+                    } else {
+                        _routes[i] = c.r;
+                    }
+
+                    for (const auto& p: c.n->_outgoing_neighbors) {
+                        auto d = p.second->d();
+                        auto d_cost = c.r.cost + p.second->cost();
+                        if (d_cost >= route_cost(d))
+                            continue;
+
+                        candidates.push_back(candidate(d, route(p.second, i, d_cost)));
+                        heap.push(std::make_pair(d_cost, candidates.size() - 1));
+                    }
+                }
+
+                /* The first candidate is the new link itself, which
+                 * wasn't found by relaxing anything. */
+                LIBOCN_COUNT(relaxations, candidates.size() - 1);
+                LIBOCN_COUNT(heap_pushes, candidates.size() - 1);
                 _paths.clear();
+            }
 
-                /* Now we just iterate until there's no new paths to
-                 * be discovered.  This is Dijkstra's Algorithm, though probably very poorly implemented... :). */
-                while (paths.size() != 0) {
-                    auto new_path = paths.top(); paths.pop();
-
-                    /* Check if there was an old path to this node.
-                     * If so we're going to need to replace the path
-                     * and re-compute everything. */
-                    auto old_path_l = _paths.find(new_path->d()->name());
-                    path_ptr old_path = NULL;
-                    if (old_path_l != _paths.end())
-                        old_path = old_path_l->second;
-
-                    /* If the old path exists and is cheaper than the
-                     * new path we just added then don't bother with
-                     * it at all, it's strictly worse than whatever we
-                     * have now. */
-                    if ((old_path != NULL) && (old_path->cost() <= new_path->cost()))
+        /* Some link in the tree just got more expensive (or went away
+         * entirely), which can only make the routes below it more
+         * expensive.  Every other route stays exactly the same, so
+         * this drops the subtree under that link and then runs
+         * Dijkstra's algorithm over just those nodes, starting from
+         * the links that lead into them from the rest of the
+         * tree. */
+        void reroute_subtree(size_t root)
+            {
+                /* Find everything that's below the root by building
+                 * a list of the children of every route. */
+                std::vector<size_t> first_child(_routes.size(), no_parent);
+                std::vector<size_t> next_sibling(_routes.size(), no_parent);
+                for (size_t i = 0; i < _routes.size(); ++i) {
+                    auto p = _routes[i].parent;
+                    if (p == no_parent)
                         continue;
+                    next_sibling[i] = first_child[p];
+                    first_child[p] = i;
+                }
 
-                    /* If this path is circular then justs abandon it here. */
-                    if (new_path->s() == new_path->d())
+                std::vector<bool> affected(_routes.size(), false);
+                std::vector<node_ptr> nodes;
+                std::vector<size_t> stack(1, root);
+                while (stack.size() != 0) {
+                    auto i = stack.back(); stack.pop_back();
+                    affected[i] = true;
+                    nodes.push_back(_routes[i].hop->d());
+                    for (auto c = first_child[i]; c != no_parent; c = next_sibling[c])
+                        stack.push_back(c);
+                }
+
+                /* Throw away the affected routes, keeping the rest in
+                 * the same order. */
+                std::vector<size_t> remap(_routes.size(), no_parent);
+                std::vector<route> kept;
+                kept.reserve(_routes.size() - nodes.size());
+                for (size_t i = 0; i < _routes.size(); ++i) {
+                    if (affected[i] == true)
                         continue;
+                    remap[i] = kept.size();
+                    kept.push_back(_routes[i]);
+                }
+                for (auto& r: kept)
+                    if (r.parent != no_parent)
+                        r.parent = remap[r.parent];
 
-                    /* Now that we know that this path is useful we
-                     * can add it to our list current path list. */
-                    _paths[new_path->d()->name()] = new_path;
+                _routes.swap(kept);
+                _paths.clear();
+                for (const auto& n: nodes)
+                    _route_index[n->uid()] = no_parent;
+                for (auto& l: _route_index)
+                    if (l != no_parent)
+                        l = remap[l];
+
+                /* Now re-attach the affected nodes, which works just
+                 * like a normal search except that it starts from
+                 * every link into those nodes from the part of the
+                 * tree that's still around. */
+                typedef std::pair<size_t, size_t> heap_entry;
+                std::priority_queue<heap_entry,
+                                    std::vector<heap_entry>,
+                                    std::greater<heap_entry>> heap;
+                std::vector<std::pair<node_ptr, route>> candidates;
+
+                auto relax = [&](const node_ptr& d, const path_ptr& hop,
+                                 size_t parent, size_t cost)
+                    {
+                        candidates.push_back(std::make_pair(d, route(hop, parent, cost)));
+                        heap.push(std::make_pair(cost, candidates.size() - 1));
+                    };
 
-                    /* Add every newly-discovered path to the queue
-                     * for processing. */
-                    for (const auto& p: new_path->d()->_outgoing_neighbors) {
-                        paths.push(new_path->cat(p.second));
+                for (const auto& n: nodes) {
+                    for (const auto& p: n->_incoming_neighbors) {
+                        auto s = p.second->s();
+                        auto s_cost = route_cost(s);
+                        if (s_cost == no_parent)
+                            continue;
+
+                        auto parent = (s->uid() == uid())
+                            ? no_parent
+                            : find_route(s->uid());
+                        relax(n, p.second, parent, s_cost + p.second->cost());
                     }
                 }
 
-                /* Now we can set that flag so this never gots called again. */
-                this->_paths_valid = true;
+                while (heap.size() != 0) {
+                    auto c = candidates[heap.top().second]; heap.pop();
+                    if (find_route(c.first->uid()) != no_parent)
+                        continue;
+
+                    auto i = _routes.size();
+                    add_route(c.first, c.second.hop, c.second.parent, c.second.cost);
+
+                    for (const auto& p: c.first->_outgoing_neighbors) {
+                        auto d = p.second->d();
+                        if (d->uid() == uid())
+                            continue;
+                        if (find_route(d->uid()) != no_parent)
+                            continue;
+                        relax(d, p.second, i, c.second.cost + p.second->cost());
+                    }
+                }
+
+                LIBOCN_COUNT(relaxations, candidates.size());
+                LIBOCN_COUNT(heap_pushes, candidates.size());
+            }
+
+        /* Returns the first port that isn't used in a port map. */
+        static size_t free_port(const std::unordered_map<size_t, path_ptr>& map)
+            {
+                size_t i = 0;
+                while ((i < map.size()) && (map.find(i) != map.end()))
+                    i++;
+
+                LIBOCN_COUNT(build_steps, i + 1);
+                return i;
+            }
+
+        /* Removes or replaces a single link in a port map. */
+        static void erase_link(std::unordered_map<size_t, path_ptr>& map,
+                               const path_ptr& link)
+            {
+                for (auto l = map.begin(); l != map.end(); ++l) {
+                    if (l->second == link) {
+                        map.erase(l);
+                        return;
+                    }
+                }
+            }
+
+        static void replace_link(std::unordered_map<size_t, path_ptr>& map,
+                                 const path_ptr& old_link,
+                                 const path_ptr& new_link)
+            {
+                for (auto& p: map)
+                    if (p.second == old_link)
+                        p.second = new_link;
             }
 
         /* A helper function for both the incoming and outgoing port
@@ -323,51 +909,13 @@ namespace libocn {
                 abort();
                 return -1;
             }
-
-    private:
-       /* This consists of the UID management code, which deals with
-        * creating a new UID for every node that's created by the
-        * system.  Note that these UIDs are keyed based on the node's
-        * string name, */
-        static size_t get_uid(const std::string& name)
-            {
-                static size_t uid = 1;
-
-                auto l = name2uid.find(name);
-                if (l != name2uid.end()) {
-                    fprintf(stderr, "re-mapped UID: '%s' -> " SIZET_FORMAT "\n",
-                            l->first.c_str(),
-                            l->second
-                        );
-                    abort();
-                }
-
-                if (uid == 0) {
-                    fprintf(stderr, "UID wraparound\n");
-                    abort();
-                }
-
-                uid++;
-                name2uid[name] = uid;
-                return uid;
-            }
-
-        static void put_uid(const std::string& name)
-            {
-                auto l = name2uid.find(name);
-                if (l == name2uid.end()) {
-                    fprintf(stderr, "uid_put for unmapped name: '%s'\n",
-                            name.c_str()
-                        );
-                    abort();
-                }
-
-                name2uid.erase(name);
-            }
     };
 
     template<class node_t>
-    std::unordered_map<std::string, size_t> node<node_t>::name2uid;
+    const size_t node<node_t>::no_uid;
+
+    template<class node_t>
+    const size_t node<node_t>::no_parent;
 }
 
 #endif
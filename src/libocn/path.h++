@@ -26,6 +26,7 @@ namespace libocn {
     template<class node_t> class path;
 }
 
+#include "counters.h++"
 #include "node.h++"
 #include <memory>
 #include <vector>
@@ -57,6 +58,7 @@ namespace libocn {
               _cost(cost),
               _steps()
             {
+                LIBOCN_COUNT(paths_allocated, 1);
             }
 
         /* Creates a path explicitly given all its parameters. */
@@ -67,6 +69,7 @@ namespace libocn {
               _cost(cost),
               _steps(weaken(steps))
             {
+                LIBOCN_COUNT(paths_allocated, 1);
             }
 
         /* Accessor functions. */
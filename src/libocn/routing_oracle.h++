@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__ROUTING_ORACLE_HXX
+#define LIBOCN__ROUTING_ORACLE_HXX
+
+namespace libocn {
+    template<class node_t> class routing_oracle;
+}
+
+#include "node.h++"
+#include "path.h++"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace libocn {
+    /* A routing oracle knows the structure of a network well enough
+     * to compute routes directly from the position of the nodes,
+     * without having to search the graph at all.  Every built-in
+     * topology provides one of these, networks that are read from a
+     * file don't.  Nodes are referred to by their index into the
+     * node list that was used to build the oracle, which is always
+     * the same as the network's node list.
+     *
+     * Subclasses must provide the cost between any two nodes, and
+     * can override the remaining routing functions if they can do
+     * better than the defaults below (which only walk the neighbors
+     * of a single node). */
+    template<class node_t>
+    class routing_oracle
+        : public std::enable_shared_from_this<routing_oracle<node_t>> {
+    protected:
+        typedef std::shared_ptr<node_t> node_ptr;
+        typedef std::shared_ptr<path<node_t>> path_ptr;
+        typedef path<node_t> path_t;
+
+    public:
+        /* Used to mark nodes that the oracle doesn't know about, or
+         * that can't be reached. */
+        static const size_t npos = (size_t)(-1);
+
+    private:
+        std::vector<node_ptr> _nodes;
+
+    public:
+        /* The nodes have to be in UID order, which is how networks
+         * store them. */
+        routing_oracle(const std::vector<node_ptr>& nodes)
+            : _nodes(nodes)
+            {
+            }
+
+        virtual ~routing_oracle(void)
+            {
+            }
+
+        /* Converts between nodes and indices. */
+        size_t size(void) const { return _nodes.size(); }
+        const node_ptr& at(size_t i) const { return _nodes[i]; }
+
+        size_t index(const node_ptr& n) const
+            {
+                auto i = uid_index(n->uid());
+                if ((i == npos) || (_nodes[i] != n))
+                    return npos;
+                return i;
+            }
+
+        size_t uid_index(size_t uid) const
+            {
+                if ((uid >= _nodes.size()) || (_nodes[uid]->uid() != uid))
+                    return npos;
+                return uid;
+            }
+
+        /* Points every node at this oracle, so they'll use it instead
+         * of searching.  Nodes only hold a weak reference, so they
+         * go back to searching if the oracle goes away. */
+        void attach(void)
+            {
+                auto self = this->shared_from_this();
+                for (const auto& n: _nodes)
+                    n->_oracle = self;
+            }
+
+        /* Undoes "attach()", which is necessary when the network no
+         * longer matches what the oracle thinks it looks like. */
+        void detach(void)
+            {
+                for (const auto& n: _nodes)
+                    n->_oracle.reset();
+            }
+
+        /* The public routing interface, in terms of nodes. */
+        size_t cost(const node_ptr& s, const node_ptr& d) const
+            { return distance(index(s), index(d)); }
+
+        size_t next_port(const node_ptr& s, const node_ptr& d) const
+            { return next_port(index(s), index(d)); }
+
+        path_ptr route(const node_ptr& s, const node_ptr& d) const
+            { return route(index(s), index(d)); }
+
+        /* Returns the cost of the route between two nodes, or "npos"
+         * if there isn't one. */
+        virtual size_t distance(size_t s, size_t d) const = 0;
+
+        /* Returns the node right before "d" on the route from "s" to
+         * "d".  Routes from any one source always form a tree. */
+        virtual size_t predecessor(size_t s, size_t d) const
+            {
+                auto c = distance(s, d);
+                for (const auto& p: _nodes[d]->_incoming_neighbors) {
+                    auto u = index(p.second->s());
+                    if (distance(s, u) + p.second->cost() == c)
+                        return u;
+                }
+
+                fprintf(stderr, "No route from '%s' to '%s'\n",
+                        _nodes[s]->name().c_str(),
+                        _nodes[d]->name().c_str()
+                    );
+                abort();
+                return npos;
+            }
+
+        /* Returns the first node after "s" on the route from "s" to
+         * "d". */
+        virtual size_t first_hop(size_t s, size_t d) const
+            {
+                auto n = d;
+                for (auto p = predecessor(s, n); p != s; p = predecessor(s, n))
+                    n = p;
+                return n;
+            }
+
+        /* Returns the port that "u" uses to send to its neighbor
+         * "v". */
+        virtual size_t port(size_t u, size_t v) const
+            {
+                return _nodes[u]->port_number_out(_nodes[v]);
+            }
+
+        /* Returns the port that "s" should send on in order to reach
+         * "d". */
+        size_t next_port(size_t s, size_t d) const
+            {
+                return port(s, first_hop(s, d));
+            }
+
+        /* Returns the link between two neighboring nodes. */
+        path_ptr link(size_t u, size_t v) const
+            {
+                const auto& out = _nodes[u]->_outgoing_neighbors;
+                auto l = out.find(port(u, v));
+                if ((l == out.end()) || (l->second->d() != _nodes[v])) {
+                    fprintf(stderr, "Oracle has no link from '%s' to '%s'\n",
+                            _nodes[u]->name().c_str(),
+                            _nodes[v]->name().c_str()
+                        );
+                    abort();
+                }
+
+                return l->second;
+            }
+
+        /* Builds the full route between two nodes, or returns NULL
+         * if there isn't one. */
+        path_ptr route(size_t s, size_t d) const
+            {
+                if ((s == d) || (distance(s, d) == npos))
+                    return NULL;
+
+                auto p = predecessor(s, d);
+                if (p == s)
+                    return link(s, d);
+
+                std::vector<node_ptr> steps;
+                for (; p != s; p = predecessor(s, p))
+                    steps.push_back(_nodes[p]);
+                std::reverse(steps.begin(), steps.end());
+
+                return std::make_shared<path_t>(_nodes[s],
+                                                _nodes[d],
+                                                steps,
+                                                distance(s, d));
+            }
+
+        /* Fills out the shortest-path tree of a node directly from
+         * the oracle.  This only modifies that node, so different
+         * sources can be installed concurrently. */
+        void install(size_t s) const
+            {
+                auto& n = *_nodes[s];
+                n.clear_routes();
+
+                std::vector<size_t> position(size(), npos);
+                size_t count = 0;
+                for (size_t d = 0; d < size(); ++d)
+                    if ((d != s) && (distance(s, d) != npos))
+                        position[d] = count++;
+
+                n._routes.reserve(count);
+                n._route_index.reserve(size());
+                for (size_t d = 0; d < size(); ++d) {
+                    if (position[d] == npos)
+                        continue;
+
+                    auto p = predecessor(s, d);
+                    auto parent = (p == s) ? node_t::no_parent : position[p];
+                    n.add_route(_nodes[d], link(p, d), parent, distance(s, d));
+                }
+
+                n._paths_valid = true;
+            }
+
+    protected:
+        /* The distance between two coordinates along one
+         * dimension. */
+        static size_t span(size_t a, size_t b)
+            {
+                return (a > b) ? (a - b) : (b - a);
+            }
+
+        /* Moves a coordinate one step towards another. */
+        static size_t toward(size_t from, size_t to)
+            {
+                return (to > from) ? (from + 1) : (from - 1);
+            }
+    };
+
+    template<class node_t>
+    const size_t routing_oracle<node_t>::npos;
+}
+
+#endif
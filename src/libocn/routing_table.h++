@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__ROUTING_TABLE_HXX
+#define LIBOCN__ROUTING_TABLE_HXX
+
+namespace libocn {
+    template<class node_t> class routing_table;
+}
+
+#include "compiled_network.h++"
+#include "network.h++"
+#include "path.h++"
+#include "routing_oracle.h++"
+#include "sizet_printf.h++"
+#include "thread_pool.h++"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace libocn {
+    /* The routing state that a router actually needs: for every
+     * destination, the output port (as in "node::port_number_out()")
+     * that a packet should be sent out of.  Rather than storing a
+     * whole path for every pair of nodes this just stores a port per
+     * pair, and full paths are rebuilt on demand by following the
+     * table from one router to the next.
+     *
+     * There are two storage formats.  The dense format is a flat
+     * array with a 16-bit port for every pair of nodes, which is
+     * what you'd want to load into a hardware table.  The interval
+     * format stores every source's table as a list of ranges of
+     * destinations (by dense index) that all use the same port.  The
+     * regular topologies number their nodes one row at a time, so
+     * with dimension-ordered routing a mesh router needs about three
+     * intervals per row rather than an entry per node. */
+    template<class node_t>
+    class routing_table {
+        typedef std::shared_ptr<node_t> node_ptr;
+        typedef std::shared_ptr<path<node_t>> path_ptr;
+        typedef path<node_t> path_t;
+        typedef compiled_network<node_t> compiled_t;
+
+    public:
+        enum class format { dense, intervals };
+
+        /* Marks a destination that can't be reached (which includes
+         * the source itself). */
+        static const uint16_t no_port = (uint16_t)(-1);
+
+    private:
+        std::shared_ptr<compiled_t> _frozen;
+        format _format;
+
+        /* The dense table, indexed by "source * size() + dest". */
+        std::vector<uint16_t> _ports;
+
+        /* The interval table: the intervals of source "s" are the
+         * ones between "_row_offsets[s]" and "_row_offsets[s+1]",
+         * and each one starts at the destination "_first[i]". */
+        std::vector<size_t> _row_offsets;
+        std::vector<uint32_t> _first;
+        std::vector<uint16_t> _port;
+
+    public:
+        /* Builds the routing table for an entire network.  Networks
+         * with a routing oracle don't need to be searched, otherwise
+         * the sources are spread out over the given number of threads
+         * (0 means one per hardware thread). */
+        routing_table(const network<node_t>& network,
+                      format f = format::dense,
+                      size_t threads = 1)
+            : _frozen(network.freeze()),
+              _format(f),
+              _ports(),
+              _row_offsets(),
+              _first(),
+              _port()
+            {
+                auto n = _frozen->size();
+                if ((f == format::intervals) && (n > (size_t)UINT32_MAX)) {
+                    fprintf(stderr, "Too many nodes for an interval table\n");
+                    abort();
+                }
+
+                /* Dense rows can be filled in directly, intervals
+                 * are collected per source and then packed. */
+                std::vector<std::vector<std::pair<uint32_t, uint16_t>>> rows;
+                if (f == format::dense)
+                    _ports.assign(n * n, no_port);
+                else
+                    rows.resize(n);
+
+                thread_pool pool(threads);
+                std::vector<typename compiled_t::search_state> states(pool.size());
+                std::vector<std::vector<uint16_t>> scratch(pool.size());
+                auto oracle = network.oracle();
+
+                pool.run(n,
+                         [&](size_t worker, size_t s)
+                         {
+                             auto row = (f == format::dense)
+                                 ? &_ports[s * n]
+                                 : (scratch[worker].resize(n), scratch[worker].data());
+
+                             if (oracle != NULL)
+                                 fill_from_oracle(*oracle, s, row);
+                             else
+                                 fill_from_search(states[worker], s, row);
+
+                             if (f == format::intervals)
+                                 compress(row, n, s, rows[s]);
+                         });
+
+                if (f == format::dense)
+                    return;
+
+                _row_offsets.reserve(n + 1);
+                _row_offsets.push_back(0);
+                for (const auto& row: rows) {
+                    for (const auto& interval: row) {
+                        _first.push_back(interval.first);
+                        _port.push_back(interval.second);
+                    }
+                    _row_offsets.push_back(_first.size());
+                }
+            }
+
+        /* The number of nodes in the table, which are numbered the
+         * same way as in "network::freeze()". */
+        size_t size(void) const { return _frozen->size(); }
+        const node_ptr& at(size_t i) const { return _frozen->at(i); }
+        size_t index(const node_ptr& n) const { return _frozen->index(n); }
+
+        format storage(void) const { return _format; }
+
+        /* The number of bytes used to store the table itself. */
+        size_t bytes(void) const
+            {
+                return _ports.size() * sizeof(uint16_t)
+                    + _row_offsets.size() * sizeof(size_t)
+                    + _first.size() * sizeof(uint32_t)
+                    + _port.size() * sizeof(uint16_t);
+            }
+
+        /* Returns the port that "s" uses to send to "d", or
+         * "no_port" if it can't. */
+        uint16_t next_port(size_t s, size_t d) const
+            {
+                if (s == d)
+                    return no_port;
+
+                if (_format == format::dense)
+                    return _ports[s * size() + d];
+
+                auto begin = _first.begin() + _row_offsets[s];
+                auto end = _first.begin() + _row_offsets[s+1];
+                auto l = std::upper_bound(begin, end, (uint32_t)d);
+                return _port[(l - _first.begin()) - 1];
+            }
+
+        uint16_t next_port(const node_ptr& s, const node_ptr& d) const
+            { return next_port(index(s), index(d)); }
+
+        /* Accessors for the interval format: every source's intervals
+         * cover all the destinations, in order. */
+        size_t interval_begin(size_t s) const { return _row_offsets[s]; }
+        size_t interval_end(size_t s) const { return _row_offsets[s+1]; }
+        size_t interval_first(size_t i) const { return _first[i]; }
+        size_t interval_last(size_t s, size_t i) const
+            {
+                return (i + 1 == interval_end(s)) ? size() - 1 : _first[i+1] - 1;
+            }
+        uint16_t interval_port(size_t i) const { return _port[i]; }
+
+        /* Rebuilds the full path between two nodes by following the
+         * table from router to router, or returns NULL if there isn't
+         * one. */
+        path_ptr route(size_t s, size_t d) const
+            {
+                if (s == d)
+                    return NULL;
+
+                std::vector<node_ptr> steps;
+                size_t cost = 0;
+                size_t last = compiled_t::npos;
+                for (auto u = s; u != d; u = _frozen->link_dest(last)) {
+                    /* A table that loops is broken, so don't follow
+                     * it forever. */
+                    if (steps.size() >= size())
+                        return NULL;
+
+                    if (u != s)
+                        steps.push_back(_frozen->at(u));
+
+                    last = find_link(u, next_port(u, d));
+                    if (last == compiled_t::npos)
+                        return NULL;
+                    cost += _frozen->link_cost(last);
+                }
+
+                if (steps.size() == 0)
+                    return _frozen->link_path(last);
+
+                return std::make_shared<path_t>(_frozen->at(s), _frozen->at(d),
+                                                steps, cost);
+            }
+
+        path_ptr route(const node_ptr& s, const node_ptr& d) const
+            { return route(index(s), index(d)); }
+
+    private:
+        /* Returns the outgoing link of a node that uses a port, or
+         * "npos" if there isn't one. */
+        size_t find_link(size_t u, uint16_t port) const
+            {
+                if (port == no_port)
+                    return compiled_t::npos;
+
+                for (size_t l = _frozen->out_begin(u); l < _frozen->out_end(u); ++l)
+                    if (_frozen->link_port(l) == port)
+                        return l;
+                return compiled_t::npos;
+            }
+
+        /* Checks that a port fits in a table entry. */
+        uint16_t check_port(size_t s, size_t port) const
+            {
+                if (port >= no_port) {
+                    fprintf(stderr, "Port " SIZET_FORMAT " of '%s' is too large for a routing table\n",
+                            port, _frozen->at(s)->name().c_str());
+                    abort();
+                }
+                return port;
+            }
+
+        /* Fills in a single source's row of the table. */
+        void fill_from_oracle(const routing_oracle<node_t>& oracle,
+                              size_t s, uint16_t *row) const
+            {
+                auto os = oracle.index(_frozen->at(s));
+                for (size_t d = 0; d < size(); ++d) {
+                    row[d] = no_port;
+                    if (d == s)
+                        continue;
+
+                    auto od = oracle.index(_frozen->at(d));
+                    row[d] = check_port(s, oracle.next_port(os, od));
+                }
+            }
+
+        void fill_from_search(typename compiled_t::search_state& state,
+                              size_t s, uint16_t *row) const
+            {
+                _frozen->search(s, state);
+
+                /* Nodes are settled in order, so the first hop to
+                 * any node is always known by the time it's
+                 * reached. */
+                std::fill(row, row + size(), no_port);
+                for (const auto& d: state.order) {
+                    auto l = state.link[d];
+                    auto parent = _frozen->link_source(l);
+                    row[d] = (parent == s)
+                        ? check_port(s, _frozen->link_port(l))
+                        : row[parent];
+                }
+            }
+
+        /* Converts a dense row to intervals.  The source's own entry
+         * doesn't matter (it's never looked up), so it just goes
+         * along with whatever interval it's in. */
+        static void compress(const uint16_t *row, size_t n, size_t s,
+                             std::vector<std::pair<uint32_t, uint16_t>>& out)
+            {
+                out.clear();
+                for (size_t d = 0; d < n; ++d) {
+                    if (d == s)
+                        continue;
+                    if (out.size() == 0)
+                        out.push_back(std::make_pair(0, row[d]));
+                    else if (out.back().second != row[d])
+                        out.push_back(std::make_pair((uint32_t)d, row[d]));
+                }
+
+                if (out.size() == 0)
+                    out.push_back(std::make_pair(0, no_port));
+            }
+    };
+
+    template<class node_t>
+    const uint16_t routing_table<node_t>::no_port;
+}
+
+#endif
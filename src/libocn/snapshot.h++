@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__SNAPSHOT_HXX
+#define LIBOCN__SNAPSHOT_HXX
+
+#include <stdint.h>
+
+namespace libocn {
+    /* The on-disk layout of a binary network snapshot, which
+     * "network" can load without parsing anything.  Every section is
+     * a flat array that starts on an 8-byte boundary, so a mapped
+     * snapshot can be read in place:
+     *
+     *   snapshot_header
+     *   uint64_t name_offsets[node_count + 1]
+     *   char names[name_bytes], padded out to 8 bytes
+     *   snapshot_link links[link_count]
+     *
+     * If the header's "routes" flag is set then it's followed by the
+     * shortest-path tree of every node, indexed by source node:
+     *
+     *   uint64_t route_offsets[node_count + 1]
+     *   snapshot_route routes[route_offsets[node_count]]
+     *
+     * Snapshots are written in the host's byte order, which is
+     * checked when they're loaded.  Any change to this layout needs
+     * a new version. */
+    struct snapshot_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t flags;
+        uint64_t node_count;
+        uint64_t link_count;
+        uint64_t name_bytes;
+    };
+
+    static const char snapshot_magic[8] = {'l', 'i', 'b', 'o', 'c', 'n', 'S', 'N'};
+    static const uint32_t snapshot_version = 1;
+    static const uint32_t snapshot_byte_order = 0x01020304;
+    static const uint64_t snapshot_routes = 1;
+
+    /* A single direct link between two nodes, which are indices into
+     * the name table. */
+    struct snapshot_link {
+        uint64_t source;
+        uint64_t dest;
+        uint64_t source_port;
+        uint64_t dest_port;
+        uint64_t cost;
+    };
+
+    /* A single entry in some node's shortest-path tree: the route
+     * ends at "dest" by taking "link" from the end of the route at
+     * index "parent", or directly from the source if that's
+     * "snapshot_no_parent". */
+    struct snapshot_route {
+        uint64_t dest;
+        uint64_t parent;
+        uint64_t cost;
+        uint64_t link;
+    };
+
+    static const uint64_t snapshot_no_parent = (uint64_t)(-1);
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "thread_pool.h++"
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace libocn;
+
+/* The part of the range that's currently owned by a single worker.
+ * The owner takes work from the front, thieves take it from the
+ * back. */
+struct work_range {
+    std::mutex lock;
+    size_t begin;
+    size_t end;
+};
+
+thread_pool::thread_pool(size_t threads)
+    : _threads(threads)
+{
+    if (_threads == 0)
+        _threads = std::thread::hardware_concurrency();
+    if (_threads == 0)
+        _threads = 1;
+}
+
+void thread_pool::run(size_t count,
+                      std::function<void(size_t, size_t)> f) const
+{
+    /* There's no point in starting any threads for a single
+     * worker. */
+    if (_threads == 1) {
+        for (size_t i = 0; i < count; ++i)
+            f(0, i);
+        return;
+    }
+
+    std::vector<work_range> ranges(_threads);
+    for (size_t w = 0; w < _threads; ++w) {
+        ranges[w].begin = count * w / _threads;
+        ranges[w].end = count * (w + 1) / _threads;
+    }
+
+    auto steal = [&](size_t w) -> bool
+        {
+            for (size_t o = 1; o < _threads; ++o) {
+                auto& victim = ranges[(w + o) % _threads];
+
+                size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> guard(victim.lock);
+                    if (victim.begin == victim.end)
+                        continue;
+
+                    begin = victim.begin + (victim.end - victim.begin) / 2;
+                    end = victim.end;
+                    victim.end = begin;
+                }
+
+                std::lock_guard<std::mutex> guard(ranges[w].lock);
+                ranges[w].begin = begin;
+                ranges[w].end = end;
+                return true;
+            }
+
+            return false;
+        };
+
+    auto work = [&](size_t w)
+        {
+            while (true) {
+                size_t i;
+                bool found = false;
+                {
+                    std::lock_guard<std::mutex> guard(ranges[w].lock);
+                    i = ranges[w].begin;
+                    if (i != ranges[w].end) {
+                        ranges[w].begin++;
+                        found = true;
+                    }
+                }
+
+                if (found == true) {
+                    f(w, i);
+                    continue;
+                }
+
+                if (steal(w) == false)
+                    return;
+            }
+        };
+
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w < _threads; ++w)
+        threads.push_back(std::thread(work, w));
+    work(0);
+
+    for (auto& thread: threads)
+        thread.join();
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of libocn.
+ *
+ * libocn is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libocn is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libocn.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBOCN__THREAD_POOL_HXX
+#define LIBOCN__THREAD_POOL_HXX
+
+#include <stdlib.h>
+#include <functional>
+
+namespace libocn {
+    /* A very simple work-stealing thread pool, which runs a function
+     * over every index in a range.  The range is split evenly
+     * between the workers up front, and whenever a worker runs out
+     * of work it steals half of whatever's left from another
+     * worker. */
+    class thread_pool {
+    private:
+        size_t _threads;
+
+    public:
+        /* Creates a pool with the given number of worker threads.  A
+         * count of 0 means one worker per hardware thread. */
+        thread_pool(size_t threads);
+
+        /* Returns the number of workers in this pool. */
+        size_t size(void) const { return _threads; }
+
+        /* Calls "f(worker, i)" for every "i" in [0, count), returning
+         * once they've all finished.  The worker number is always
+         * less than "size()" and is never shared by two concurrent
+         * calls, so it can be used to index per-thread scratch
+         * space. */
+        void run(size_t count, std::function<void(size_t, size_t)> f) const;
+    };
+}
+
+#endif
@@ -0,0 +1,42 @@
+#include "tempdir.bash"
+
+# Builds every topology at two sizes and checks that the work done
+# while building them grows with the size of the network rather than
+# its square.  Both the allocation count and the "build_steps" counter
+# are exact, so unlike timing this can't be thrown off by a busy
+# machine: anything quadratic would grow four times faster than the
+# network does, which is well past the factor of two allowed here.
+$PTEST_BINARY --steps 2 > bench.json
+
+# Pulls out one line per benchmark: its topology, size (nodes plus
+# links), construction allocations and build steps.
+awk -F': ' '
+    /"topology"/                 { gsub(/[",]/, "", $2); t = $2 }
+    /"nodes"/                    { gsub(/,/, "", $2); n = $2 }
+    /"links"/                    { gsub(/,/, "", $2); l = $2 }
+    /"construction_allocations"/ { gsub(/,/, "", $2); a = $2 }
+    /"build_steps"/              { print t, n + l, a, $2 }
+' bench.json > work
+cat work
+
+for topology in mesh dmesh cmesh crossbar crossmesh file
+do
+    small=($(grep "^$topology " work | head -n 1))
+    large=($(grep "^$topology " work | tail -n 1))
+
+    if [[ "${large[1]}" -le "${small[1]}" ]]
+    then
+        echo "$topology didn't get any bigger"
+        exit 1
+    fi
+
+    for i in 2 3
+    do
+        if [[ "$((${large[$i]} * ${small[1]}))" -gt \
+              "$((2 * ${small[$i]} * ${large[1]}))" ]]
+        then
+            echo "Building $topology grew faster than the network did"
+            exit 1
+        fi
+    done
+done
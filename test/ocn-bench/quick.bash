@@ -0,0 +1,35 @@
+#include "tempdir.bash"
+
+# Runs the smallest size of every benchmark, just to make sure they
+# all run and report something sensible.
+$PTEST_BINARY --steps 1 > bench.json
+cat bench.json
+
+for topology in mesh dmesh cmesh crossbar crossmesh file
+do
+    if [[ "$(grep -c "\"topology\": \"$topology\"" bench.json)" != "1" ]]
+    then
+        echo "Missing results for $topology"
+        exit 1
+    fi
+done
+
+grep -q '"counters": true' bench.json
+
+# Only the file-based network actually searches, and it's the only one
+# that reads anything.
+if [[ "$(grep '"relaxations": [1-9]' bench.json | wc -l)" != "1" ]]
+then
+    echo "Expected exactly one benchmark to search"
+    exit 1
+fi
+
+if [[ "$(grep '"bytes_read": [1-9]' bench.json | wc -l)" != "1" ]]
+then
+    echo "Expected exactly one benchmark to read a file"
+    exit 1
+fi
+
+# The output should end with a closing brace on its own line, which
+# catches most truncated output.
+[[ "$(tail -n 1 bench.json)" == "}" ]]
@@ -0,0 +1,13 @@
+#include "tempdir.bash"
+
+# Node names used to be limited by the size of the line buffer.
+name="$(printf 'n%.0s' $(seq 1 3000))"
+
+cat >gold.stdout <<EOF
+"$name-a" 0 -> "$name-b" 0: 1
+"$name-b" 0 -> "$name-a" 0: 2
+EOF
+
+ARGS="--file gold.stdout"
+
+#include "harness.bash"
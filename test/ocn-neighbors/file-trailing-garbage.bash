@@ -0,0 +1,26 @@
+#include "tempdir.bash"
+
+# Anything after the cost used to be silently ignored, so a typo like
+# "1 5" would quietly load as a cost of 1.
+cat >network <<EOF2
+"a" 0 -> "b" 0: 1 5
+"b" 0 -> "a" 0: 2
+EOF2
+
+if $PTEST_BINARY --file network > /dev/null 2> test.stderr
+then
+    echo "Loaded a network with trailing garbage"
+    exit 1
+fi
+grep "Expected the end of the line" test.stderr
+
+# Trailing whitespace is still fine, though.
+cat >gold.stdout <<EOF2
+"a" 0 -> "b" 0: 1
+"b" 0 -> "a" 0: 2
+EOF2
+
+printf '"a" 0 -> "b" 0: 1 \t\n"b" 0 -> "a" 0: 2\r\n' > network
+ARGS="--file network"
+
+#include "harness.bash"
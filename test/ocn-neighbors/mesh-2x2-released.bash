@@ -0,0 +1,20 @@
+#include "tempdir.bash"
+
+# The network is thrown away before its frozen view is printed, so
+# this checks that the links (which live in the network's arena) stay
+# around for as long as something still refers to them.  A memory
+# checker makes this a lot more thorough.
+cat >gold.stdout <<EOF2
+"(0, 0)" 0 -> "(1, 0)" 0: 1
+"(0, 0)" 1 -> "(0, 1)" 0: 1
+"(1, 0)" 0 -> "(0, 0)" 1: 1
+"(1, 0)" 1 -> "(1, 1)" 1: 1
+"(0, 1)" 0 -> "(1, 1)" 0: 1
+"(0, 1)" 1 -> "(0, 0)" 0: 1
+"(1, 1)" 0 -> "(0, 1)" 1: 1
+"(1, 1)" 1 -> "(1, 0)" 1: 1
+EOF2
+
+ARGS="--mesh 2 2"
+
+#include "harness.bash"
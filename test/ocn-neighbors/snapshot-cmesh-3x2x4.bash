@@ -0,0 +1,9 @@
+#include "tempdir.bash"
+
+# Round-trips a concentrated mesh through a snapshot, which needs to
+# keep every port number.
+$PTEST_BINARY --write-snapshot snapshot --cmesh 3 2 4 > gold.stdout
+
+ARGS="--file snapshot"
+
+#include "harness.bash"
@@ -0,0 +1,3 @@
+ARGS="--cmesh 3 2 4"
+
+#include "harness.bash"
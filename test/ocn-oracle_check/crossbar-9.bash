@@ -0,0 +1,3 @@
+ARGS="--crossbar 9"
+
+#include "harness.bash"
@@ -0,0 +1,3 @@
+ARGS="--crossmesh 3 3 4"
+
+#include "harness.bash"
@@ -0,0 +1,3 @@
+ARGS="--crossmesh 4 2 9"
+
+#include "harness.bash"
@@ -0,0 +1,26 @@
+#include "tempdir.bash"
+
+# Checks every crossmesh up to 5x5 with up to 16 nodes per crossbar,
+# which should shake out any corner cases that the fixed sizes miss.
+for x in $(seq 1 5)
+do
+    for y in $(seq 1 5)
+    do
+        for side in $(seq 1 4)
+        do
+            ARGS="--crossmesh $x $y $(( $side * $side ))"
+            if ! $PTEST_BINARY $ARGS > test.stdout
+            then
+                echo "Failed to check $ARGS"
+                exit 1
+            fi
+
+            if [[ "$(cat test.stdout | wc -l)" != "0" ]]
+            then
+                echo "Oracle disagrees with the search for $ARGS"
+                cat test.stdout
+                exit 1
+            fi
+        done
+    done
+done
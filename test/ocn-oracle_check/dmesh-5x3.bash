@@ -0,0 +1,3 @@
+ARGS="--dmesh 5 3"
+
+#include "harness.bash"
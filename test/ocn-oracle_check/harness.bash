@@ -0,0 +1,10 @@
+#include "tempdir.bash"
+
+time $PTEST_BINARY $ARGS > test.stdout
+
+cat test.stdout
+if [[ "$(cat test.stdout | wc -l)" != "0" ]]
+then
+    echo "Oracle disagrees with the search"
+    exit 1
+fi
@@ -0,0 +1,3 @@
+ARGS="--mesh 7 4"
+
+#include "harness.bash"
@@ -0,0 +1,23 @@
+#include "tempdir.bash"
+
+# The same ring as "file-weighted.bash", where each node's whole table
+# fits in a single interval.
+cat >network <<EOF
+"a" 0 -> "b" 0: 1
+"b" 1 -> "c" 1: 1
+"c" 2 -> "d" 2: 1
+"a" 1 -> "d" 0: 5
+"d" 1 -> "a" 2: 1
+"b" 2 -> "d" 1: 4
+EOF
+
+cat >gold.stdout <<EOF
+"a" -> "a" .. "d": 0
+"b" -> "a" .. "d": 1
+"c" -> "a" .. "d": 2
+"d" -> "a" .. "d": 1
+EOF
+
+ARGS="--intervals --file network"
+
+#include "harness.bash"
@@ -0,0 +1,31 @@
+#include "tempdir.bash"
+
+# A small ring where the direct links are more expensive than going
+# the long way around, so every node only ever uses one port.
+cat >network <<EOF
+"a" 0 -> "b" 0: 1
+"b" 1 -> "c" 1: 1
+"c" 2 -> "d" 2: 1
+"a" 1 -> "d" 0: 5
+"d" 1 -> "a" 2: 1
+"b" 2 -> "d" 1: 4
+EOF
+
+cat >gold.stdout <<EOF
+"a" -> "b": 0
+"a" -> "c": 0
+"a" -> "d": 0
+"b" -> "a": 1
+"b" -> "c": 1
+"b" -> "d": 1
+"c" -> "a": 2
+"c" -> "b": 2
+"c" -> "d": 2
+"d" -> "a": 1
+"d" -> "b": 1
+"d" -> "c": 1
+EOF
+
+ARGS="--file network"
+
+#include "harness.bash"
@@ -0,0 +1,5 @@
+WIDTH="6"
+HEIGHT="4"
+FORMAT="--intervals"
+
+#include "mesh_walk_harness.bash"
@@ -0,0 +1,4 @@
+WIDTH="6"
+HEIGHT="4"
+
+#include "mesh_walk_harness.bash"
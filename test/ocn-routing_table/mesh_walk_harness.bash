@@ -0,0 +1,27 @@
+#include "tempdir.bash"
+
+# Rebuilds every path in a mesh by following the routing table from
+# router to router, which should always find the shortest path.
+for sx in $(seq 0 $(($WIDTH - 1)))
+do
+    for sy in $(seq 0 $(($HEIGHT - 1)))
+    do
+        for dx in $(seq 0 $(($WIDTH - 1)))
+        do
+            for dy in $(seq 0 $(($HEIGHT - 1)))
+            do
+                if [[ "$sx" != "$dx" || "$sy" != "$dy" ]]
+                then
+                    xd=$(($sx - $dx))
+                    yd=$(($sy - $dy))
+                    cost=$((${xd#-} + ${yd#-}))
+                    echo "\"($sx, $sy)\" -> \"($dx, $dy)\": $cost" >> gold.stdout
+                fi
+            done
+        done
+    done
+done
+
+ARGS="$FORMAT --walk --mesh $WIDTH $HEIGHT"
+
+#include "harness.bash"
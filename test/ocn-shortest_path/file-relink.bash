@@ -0,0 +1,50 @@
+#include "tempdir.bash"
+
+# The same weighted ring as "file-weighted.bash", but with a few links
+# changed after the routes have already been computed: this checks
+# the incremental route updates rather than the initial search.
+cat >network <<EOF
+"a" 0 -> "b" 0: 1
+"b" 1 -> "c" 1: 1
+"c" 2 -> "d" 2: 1
+"a" 1 -> "d" 0: 5
+"d" 1 -> "a" 2: 1
+"b" 2 -> "d" 1: 4
+EOF
+
+cat >gold.stdout <<EOF
+"a" -> "b": 1
+"a" -> "d": 1
+"b" -> "d": 4
+"b" -> "a": 5
+"c" -> "d": 1
+"c" -> "a": 2
+"c" -> "b": 3
+"d" -> "a": 1
+"d" -> "b": 2
+EOF
+
+# Only the sources that actually route over a changed link should
+# have to recompute anything: making "a -> d" cheaper only changes the
+# routes from "a", and removing "b -> c" changes the routes from "a",
+# "b" and "d", so that's three sources in all.  Re-weighting a link to
+# the cost it already has shouldn't change anything at all.
+check_recomputed() {
+    expected="$1"
+    shift
+
+    $PTEST_BINARY "$@" > /dev/null 2> test.stderr
+    if [[ "$(cat test.stderr)" != "Recomputed routes for $expected sources" ]]
+    then
+        echo "Expected $expected sources to be recomputed for $@"
+        cat test.stderr
+        exit 1
+    fi
+}
+
+check_recomputed 3 --link-cost a d 1 --remove-link b c --file network
+check_recomputed 0 --link-cost a d 5 --file network
+
+ARGS="--link-cost a d 1 --remove-link b c --file network"
+
+#include "harness.bash"
@@ -0,0 +1,31 @@
+#include "tempdir.bash"
+
+# A small ring where the direct links are more expensive than going
+# the long way around, which forces the weighted search.
+cat >network <<EOF
+"a" 0 -> "b" 0: 1
+"b" 1 -> "c" 1: 1
+"c" 2 -> "d" 2: 1
+"a" 1 -> "d" 0: 5
+"d" 1 -> "a" 2: 1
+"b" 2 -> "d" 1: 4
+EOF
+
+cat >gold.stdout <<EOF
+"a" -> "b": 1
+"a" -> "c": 2
+"a" -> "d": 3
+"b" -> "c": 1
+"b" -> "d": 2
+"b" -> "a": 3
+"c" -> "d": 1
+"c" -> "a": 2
+"c" -> "b": 3
+"d" -> "a": 1
+"d" -> "b": 2
+"d" -> "c": 3
+EOF
+
+ARGS="--file network"
+
+#include "harness.bash"
@@ -0,0 +1,24 @@
+#include "tempdir.bash"
+
+# Builds several copies of the same mesh at once, which share every
+# node name, and checks that each copy gets exactly the same routes
+# as a mesh that was built on its own.
+COPIES="4"
+
+$PTEST_BINARY --remove-link "(1, 1)" "(2, 1)" --mesh 5 5 > single.stdout
+
+for i in $(seq 1 $COPIES)
+do
+    cat single.stdout
+done > gold.stdout
+
+$PTEST_BINARY --threads $COPIES --copies $COPIES \
+    --remove-link "(1, 1)" "(2, 1)" \
+    --mesh 5 5 \
+    > test.stdout
+
+cat test.stdout | sort > test.stdout.sort
+cat gold.stdout | sort > gold.stdout.sort
+
+diff -u test.stdout.sort gold.stdout.sort
+exit $?
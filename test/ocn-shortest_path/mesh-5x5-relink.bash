@@ -0,0 +1,54 @@
+#include "tempdir.bash"
+
+# Changes a few links in a mesh after its routes have been computed,
+# and then checks the result against searching a network file that
+# had those changes from the start.
+WIDTH="5"
+HEIGHT="5"
+
+for x in $(seq 0 $(($WIDTH - 1)))
+do
+    for y in $(seq 0 $(($HEIGHT - 1)))
+    do
+        link() {
+            if [[ "$1" -ge 0 && "$1" -lt $WIDTH && "$2" -ge 0 && "$2" -lt $HEIGHT ]]
+            then
+                echo "\"($x, $y)\" $3 -> \"($1, $2)\" $4: 1"
+            fi
+        }
+
+        link $(($x - 1)) $y 0 1
+        link $(($x + 1)) $y 1 0
+        link $x $(($y - 1)) 2 3
+        link $x $(($y + 1)) 3 2
+    done
+done \
+    | grep -v '^"(1, 1)" 1 -> "(2, 1)"' \
+    | sed 's/^\("(2, 2)" 3 -> "(2, 3)" 2\): 1$/\1: 7/' \
+    > network
+
+$PTEST_BINARY --file network > gold.stdout
+
+$PTEST_BINARY --threads 2 \
+    --remove-link "(1, 1)" "(2, 1)" \
+    --link-cost "(2, 2)" "(2, 3)" 7 \
+    --mesh $WIDTH $HEIGHT \
+    > test.stdout
+
+# Dimension-order routes only use "(1, 1) -> (2, 1)" from "(0, 1)"
+# and "(1, 1)", so removing it should only have to recompute those
+# two sources.
+$PTEST_BINARY --remove-link "(1, 1)" "(2, 1)" --mesh $WIDTH $HEIGHT \
+    > /dev/null 2> test.stderr
+if [[ "$(cat test.stderr)" != "Recomputed routes for 2 sources" ]]
+then
+    echo "Removing a link recomputed the wrong number of sources"
+    cat test.stderr
+    exit 1
+fi
+
+cat test.stdout | sort > test.stdout.sort
+cat gold.stdout | sort > gold.stdout.sort
+
+diff -u test.stdout.sort gold.stdout.sort
+exit $?
@@ -0,0 +1,5 @@
+WIDTH="9"
+HEIGHT="9"
+THREADS="4"
+
+#include "mesh_harness.bash"
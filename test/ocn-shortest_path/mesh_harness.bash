@@ -1,6 +1,10 @@
 #include "tempdir.bash"
 
 ARGS="--mesh $WIDTH $HEIGHT"
+if [[ "$THREADS" != "" ]]
+then
+    ARGS="--threads $THREADS $ARGS"
+fi
 
 # Generate the correct output file that is expected to match
 for sx in $(seq 0 $(($WIDTH - 1)))
@@ -0,0 +1,45 @@
+#include "tempdir.bash"
+
+# Routes are read straight out of a snapshot, so a corrupted route
+# table has to be caught when it's loaded rather than producing
+# routes that don't match the network.
+cat >network <<EOF2
+"a" 0 -> "b" 0: 1
+"b" 1 -> "c" 1: 1
+"c" 2 -> "d" 2: 1
+"a" 1 -> "d" 0: 5
+"d" 1 -> "a" 2: 1
+"b" 2 -> "d" 1: 4
+EOF2
+
+$PTEST_BINARY --write-snapshot snapshot --file network > gold.stdout
+
+# The route table comes last, and each route is four 64-bit words
+# (dest, parent, cost, link), so the last two routes are at the very
+# end of the file.
+size=$(stat -c %s snapshot)
+
+check_corrupt() {
+    expected="$1"
+
+    if $PTEST_BINARY --file corrupt > /dev/null 2> test.stderr
+    then
+        echo "Loaded a snapshot with a bad route table"
+        exit 1
+    fi
+    grep "$expected" test.stderr
+}
+
+cp snapshot corrupt
+printf '\143\0\0\0\0\0\0\0' | \
+    dd of=corrupt bs=1 seek=$((size - 16)) conv=notrunc
+check_corrupt "route cost doesn't match its links"
+
+cp snapshot corrupt
+dd if=snapshot of=corrupt bs=1 skip=$((size - 64)) seek=$((size - 32)) \
+    count=8 conv=notrunc
+check_corrupt "duplicate route destination"
+
+ARGS="--file snapshot"
+
+#include "harness.bash"
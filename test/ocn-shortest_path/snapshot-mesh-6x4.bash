@@ -0,0 +1,8 @@
+#include "tempdir.bash"
+
+# Round-trips a mesh (and all its routes) through a snapshot.
+$PTEST_BINARY --write-snapshot snapshot --mesh 6 4 > gold.stdout
+
+ARGS="--file snapshot"
+
+#include "harness.bash"
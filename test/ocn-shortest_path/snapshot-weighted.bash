@@ -0,0 +1,21 @@
+#include "tempdir.bash"
+
+# Saves a weighted network (along with its routes, some of which have
+# been changed incrementally) as a snapshot, and then checks that the
+# routes that are loaded back in match.
+cat >network <<EOF
+"a" 0 -> "b" 0: 1
+"b" 1 -> "c" 1: 1
+"c" 2 -> "d" 2: 1
+"a" 1 -> "d" 0: 5
+"d" 1 -> "a" 2: 1
+"b" 2 -> "d" 1: 4
+EOF
+
+$PTEST_BINARY --link-cost a d 1 --link-cost c a 1 \
+    --write-snapshot snapshot --file network \
+    > gold.stdout
+
+ARGS="--file snapshot"
+
+#include "harness.bash"